@@ -0,0 +1,197 @@
+#pragma once
+
+#include "shared.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Moves final destructions of big objects off latency-critical threads:
+//     UniquePtr<Index, AsyncDeleter<Index>> index(new Index(...));
+//     auto shared = MakeSharedAsync<Index>(args...);
+// Releasing the last owner only enqueues the pointer. The first object queued wakes a background
+// thread, which then waits `interval` (or until the queue is half full) and destroys everything
+// queued so far as one batch, so the releasing thread rarely wakes it and is not preempted by it.
+// An idle queue does not wake up at all.
+//
+// The queue never holds more than `max_pending` objects: beyond that (and once the queue is shut
+// down) the releasing thread destroys the object itself, as if there were no queue. `Flush`
+// waits until everything queued before it is destroyed. Objects released on the background
+// thread itself (from destructors it runs) are queued as well.
+class ReclamationQueue {
+    struct Item {
+        void* ptr;
+        void (*destroy)(void*) noexcept;
+    };
+
+public:
+    explicit ReclamationQueue(size_t max_pending = 4096,
+                              std::chrono::microseconds interval = std::chrono::milliseconds(10))
+        : max_pending_(max_pending), interval_(interval) {
+        // Both lists only ever swap, so enqueueing never allocates
+        pending_.reserve(max_pending_);
+        batch_.reserve(max_pending_);
+        worker_ = std::thread([this] { Run(); });
+    }
+
+    ReclamationQueue(const ReclamationQueue&) = delete;
+    ReclamationQueue& operator=(const ReclamationQueue&) = delete;
+
+    ~ReclamationQueue() {
+        Shutdown();
+    }
+
+    // Shared by `AsyncDeleter` and `MakeSharedAsync`. Shut down by `std::atexit`: objects
+    // queued until then are destroyed and the thread joined before the statics created before
+    // the first use of the queue go away; releases after that destroy inline.
+    static ReclamationQueue& Default() {
+        static ReclamationQueue* queue = [] {
+            auto created = new ReclamationQueue();
+            std::atexit([] { Default().Shutdown(); });
+            return created;
+        }();
+        return *queue;
+    }
+
+    // Destroys whatever is still queued and stops the thread; later releases destroy inline
+    void Shutdown() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (stop_) {
+                return;
+            }
+            stop_ = true;
+        }
+        wake_worker_.notify_one();
+        worker_.join();
+    }
+
+    template <typename T>
+    void Retire(T* ptr) noexcept {
+        Enqueue(ptr, [](void* object) noexcept { delete static_cast<T*>(object); });
+    }
+
+    template <typename T>
+    void RetireArray(T* ptr) noexcept {
+        Enqueue(ptr, [](void* object) noexcept { delete[] static_cast<T*>(object); });
+    }
+
+    // Must not be called from the objects' destructors
+    void Flush() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        uint64_t target = enqueued_;
+        flush_requested_ = true;
+        wake_worker_.notify_one();
+        flushed_.wait(guard, [&] { return destroyed_ >= target; });
+    }
+
+    size_t Pending() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return pending_.size();
+    }
+
+    // Deleter bound to a specific queue; `AsyncDeleter` uses `Default()` and takes no space
+    template <typename T>
+    class Deleter {
+    public:
+        explicit Deleter(ReclamationQueue& queue) noexcept : queue_(&queue) {
+        }
+
+        void operator()(T* ptr) const noexcept {
+            queue_->Retire(ptr);
+        }
+
+    private:
+        ReclamationQueue* queue_;
+    };
+
+private:
+    void Enqueue(void* ptr, void (*destroy)(void*) noexcept) noexcept {
+        if (!ptr) {
+            return;
+        }
+        std::unique_lock<std::mutex> guard(mutex_);
+        if (stop_ || pending_.size() >= max_pending_) {
+            guard.unlock();
+            destroy(ptr);
+            return;
+        }
+        // Within the reserved capacity, so this does not allocate
+        pending_.push_back({ptr, destroy});
+        ++enqueued_;
+        bool wake = pending_.size() == 1 || pending_.size() == max_pending_ / 2 + 1;
+        guard.unlock();
+        if (wake) {
+            wake_worker_.notify_one();
+        }
+    }
+
+    void Run() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        while (true) {
+            // Idle until something is queued, then give the batch `interval_` to fill up
+            wake_worker_.wait(guard,
+                              [&] { return stop_ || flush_requested_ || !pending_.empty(); });
+            wake_worker_.wait_for(guard, interval_, [&] {
+                return stop_ || flush_requested_ || pending_.size() > max_pending_ / 2;
+            });
+            flush_requested_ = false;
+            if (stop_ && pending_.empty()) {
+                return;
+            }
+            batch_.swap(pending_);
+            guard.unlock();
+            for (const Item& item : batch_) {
+                item.destroy(item.ptr);
+            }
+            guard.lock();
+            destroyed_ += batch_.size();
+            batch_.clear();
+            flushed_.notify_all();
+        }
+    }
+
+    const size_t max_pending_;
+    const std::chrono::microseconds interval_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_worker_;
+    std::condition_variable flushed_;
+    std::vector<Item> pending_;
+    // What the worker is destroying, only touched by it
+    std::vector<Item> batch_;
+    uint64_t enqueued_{0};
+    uint64_t destroyed_{0};
+    bool flush_requested_{false};
+    bool stop_{false};
+    std::thread worker_;
+};
+
+template <typename T>
+class AsyncDeleter {
+public:
+    void operator()(T* ptr) const noexcept {
+        ReclamationQueue::Default().Retire(ptr);
+    }
+};
+
+template <typename T>
+class AsyncDeleter<T[]> {
+public:
+    void operator()(T* ptr) const noexcept {
+        ReclamationQueue::Default().RetireArray(ptr);
+    }
+};
+
+// Like `MakeSharedSplit`, but the object is destroyed on the background thread of the default
+// queue; the control block is still freed inline
+template <typename U, typename Policy = DefaultRefCount, typename... Args>
+SharedPtr<U, Policy> MakeSharedAsync(Args&&... args) {
+    static_assert(!std::is_array_v<U>, "MakeSharedAsync does not support arrays");
+    return SharedPtr<U, Policy>(new U(std::forward<Args>(args)...), AsyncDeleter<U>());
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "compact_shared.h"
+#include "shared.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+
+// Lock-free atomic `SharedPtr` built on split reference counting.
+//
+// The atomic word packs the control block of the stored value (low 48 bits) with the number of
+// readers that have reserved a reference but not yet settled it (high 16 bits), so `Load` is a
+// single atomic increment of the word followed by an ordinary `IncRef` on the block. A writer
+// that swaps the block out converts the outstanding reservations into strong references; a
+// reader whose reservation was converted drops the extra one. The atomic itself owns one strong
+// reference on the stored block.
+//
+// Pointers returned by `Load` and `Exchange` share the object's own control block, so they count
+// in `UseCount`, compare equal with `OwnerEqual` and keep `WeakPtr`s alive like any other copy.
+// Only a pointer that does not point at its block's object (the aliasing constructor, a base
+// class at a non-zero offset) is stored through a small `CompactAliasBlock`, allocated by
+// `Store`; loading it still hands out a reference on the real block. `CompareExchange`
+// compares the pointer and the owning block, like `std::atomic<std::shared_ptr>`.
+//
+// At most 65535 readers can hold a reservation at a time; `Load` waits for one to settle
+// before going over.
+template <typename T>
+class AtomicSharedPtr {
+    using Element = std::remove_extent_t<T>;
+    using Block = ControlBlockBase<DefaultRefCount>;
+    using AliasBlock = CompactAliasBlock<Element, DefaultRefCount>;
+
+    static_assert(sizeof(void*) == 8, "AtomicSharedPtr packs a 48-bit pointer into 64 bits");
+
+    static constexpr int kCountShift = 48;
+    static constexpr uint64_t kOneReader = uint64_t{1} << kCountShift;
+    static constexpr uint64_t kPointerMask = kOneReader - 1;
+    static constexpr uint64_t kMaxReaders = (uint64_t{1} << (64 - kCountShift)) - 1;
+    // Set in the pointer bits when the block is a `CompactAliasBlock`
+    static constexpr uint64_t kAliasBit = 1;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    AtomicSharedPtr() {
+    }
+
+    AtomicSharedPtr(SharedPtr<T> desired) : word_(Encode(std::move(desired))) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~AtomicSharedPtr() {
+        Release(word_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Operations
+
+    SharedPtr<T> Load() const {
+        return Adopt(Acquire());
+    }
+
+    void Store(SharedPtr<T> desired) {
+        Release(word_.exchange(Encode(std::move(desired)), std::memory_order_acq_rel));
+    }
+
+    SharedPtr<T> Exchange(SharedPtr<T> desired) {
+        uint64_t old = word_.exchange(Encode(std::move(desired)), std::memory_order_acq_rel);
+        ConvertReservations(old);
+        return Adopt(old & kPointerMask);
+    }
+
+    // On failure `expected` is replaced with the current value
+    bool CompareExchange(SharedPtr<T>& expected, SharedPtr<T> desired) {
+        uint64_t next = Encode(std::move(desired));
+        while (true) {
+            // The reference keeps the current block from being freed and its address reused
+            // while it is compared
+            uint64_t held = Acquire();
+            if (!Matches(held, expected)) {
+                Release(next);
+                expected = Adopt(held);
+                return false;
+            }
+            uint64_t current = word_.load(std::memory_order_acquire);
+            while ((current & kPointerMask) == held) {
+                if (word_.compare_exchange_weak(current, next, std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+                    Release(current);
+                    Release(held);
+                    return true;
+                }
+            }
+            // Replaced in the meantime, maybe by an equal value
+            Release(held);
+        }
+    }
+
+    bool IsLockFree() const {
+        return word_.is_lock_free();
+    }
+
+private:
+    // Takes over `value`'s reference
+    static uint64_t Encode(SharedPtr<T> value) {
+        if (!value.block_ && !value.ptr_) {
+            return 0;
+        }
+        uint64_t bits;
+        if (value.block_ && value.block_->GetObject() == ToVoid(value.ptr_)) {
+            bits = Pack(value.block_);
+        } else {
+            bits = Pack(new AliasBlock(value.ptr_, value.block_)) | kAliasBit;
+        }
+        value.ptr_ = nullptr;
+        value.block_ = nullptr;
+        return bits;
+    }
+
+    static uint64_t Pack(Block* block) {
+        auto bits = reinterpret_cast<uintptr_t>(block);
+        assert((bits & ~kPointerMask) == 0 && (bits & kAliasBit) == 0);
+        return bits;
+    }
+
+    static Block* Unpack(uint64_t word) {
+        return reinterpret_cast<Block*>(static_cast<uintptr_t>(word & kPointerMask & ~kAliasBit));
+    }
+
+    static const void* ToVoid(const Element* ptr) {
+        return ptr;
+    }
+
+    // The pointer bits of the current value, with one strong reference on its block
+    uint64_t Acquire() const {
+        uint64_t reserved = word_.load(std::memory_order_relaxed);
+        while (true) {
+            if ((reserved >> kCountShift) == kMaxReaders) {
+                std::this_thread::yield();
+                reserved = word_.load(std::memory_order_relaxed);
+            } else if (word_.compare_exchange_weak(reserved, reserved + kOneReader,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        Block* block = Unpack(reserved);
+        if (block) {
+            block->IncRef();
+        }
+
+        // Give the reservation back unless a writer already converted it
+        uint64_t current = word_.load(std::memory_order_relaxed);
+        while (true) {
+            if ((current & kPointerMask) != (reserved & kPointerMask) ||
+                (current >> kCountShift) == 0) {
+                if (block) {
+                    block->DecRef();
+                }
+                break;
+            }
+            if (word_.compare_exchange_weak(current, current - kOneReader,
+                                            std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        return reserved & kPointerMask;
+    }
+
+    // Whether the held value is `expected`: the same pointer owned by the same block
+    static bool Matches(uint64_t held, const SharedPtr<T>& expected) {
+        Block* block = Unpack(held);
+        if (!block) {
+            return !expected.ptr_ && !expected.block_;
+        }
+        if (held & kAliasBit) {
+            auto alias = static_cast<AliasBlock*>(block);
+            return alias->ptr_ == expected.ptr_ && alias->owner_ == expected.block_;
+        }
+        return block == expected.block_ && block->GetObject() == ToVoid(expected.ptr_);
+    }
+
+    // Readers that reserved `old` and lost the race each get a strong reference from the writer
+    static void ConvertReservations(uint64_t old) {
+        Block* block = Unpack(old);
+        if (!block) {
+            return;
+        }
+        for (uint64_t readers = old >> kCountShift; readers > 0; --readers) {
+            block->IncRef();
+        }
+    }
+
+    static void Release(uint64_t old) {
+        ConvertReservations(old);
+        if (Block* block = Unpack(old)) {
+            block->DecRef();
+        }
+    }
+
+    // Takes over one strong reference on the block in `bits`
+    static SharedPtr<T> Adopt(uint64_t bits) {
+        SharedPtr<T> sp;
+        Block* block = Unpack(bits);
+        if (!block) {
+            return sp;
+        }
+        if (bits & kAliasBit) {
+            auto alias = static_cast<AliasBlock*>(block);
+            sp = SharedPtr<T>(alias->ptr_, alias->owner_);
+            alias->DecRef();
+        } else {
+            sp.ptr_ = static_cast<Element*>(block->GetObject());
+            sp.block_ = block;
+        }
+        return sp;
+    }
+
+    mutable std::atomic<uint64_t> word_{0};
+};
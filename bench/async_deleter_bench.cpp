@@ -0,0 +1,61 @@
+// Latency distribution of releasing the last owner of a big object (many small heap blocks, like
+// an index), destroying it inline versus handing it to `AsyncDeleter`'s background thread.
+
+#include "async_deleter.h"
+#include "unique.h"
+#include "bench/bench.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+constexpr size_t kIterations = 500;
+
+struct Index {
+    Index() : keys(20000, std::string(40, 'k')) {
+    }
+
+    std::vector<std::string> keys;
+};
+
+// `make()` builds an owner outside the timed region, `release(owner)` is timed
+template <typename Make, typename Release>
+void Run(const char* name, Make make, Release release) {
+    std::vector<double> latencies;
+    latencies.reserve(kIterations);
+    for (size_t i = 0; i < kIterations; ++i) {
+        auto owner = make();
+        auto begin = std::chrono::steady_clock::now();
+        release(owner);
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - begin;
+        latencies.push_back(elapsed.count());
+        // Let the background thread catch up outside the timed region, like a request thread
+        // that has other work between releases
+        ReclamationQueue::Default().Flush();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    std::printf("%-28s %10.2f %10.2f %10.2f %10.2f %10.2f\n", name, percentile(0.5),
+                percentile(0.9), percentile(0.99), percentile(0.999), latencies.back());
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%-28s %10s %10s %10s %10s %10s\n", "release (us)", "p50", "p90", "p99", "p99.9",
+                "max");
+    Run("UniquePtr_DefaultDeleter", [] { return UniquePtr<Index>(new Index); },
+        [](auto& owner) { owner.Reset(); });
+    Run("UniquePtr_AsyncDeleter",
+        [] { return UniquePtr<Index, AsyncDeleter<Index>>(new Index); },
+        [](auto& owner) { owner.Reset(); });
+    Run("SharedPtr_MakeShared", [] { return MakeShared<Index>(); },
+        [](auto& owner) { owner.Reset(); });
+    Run("SharedPtr_MakeSharedAsync", [] { return MakeSharedAsync<Index>(); },
+        [](auto& owner) { owner.Reset(); });
+    return 0;
+}
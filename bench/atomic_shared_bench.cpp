@@ -0,0 +1,66 @@
+// Multi-reader scaling: `AtomicSharedPtr::Load` versus a mutex-protected `SharedPtr`, with one
+// writer republishing the value in the background.
+
+#include "atomic_shared.h"
+#include "bench/bench.h"
+
+#include <mutex>
+
+namespace {
+
+struct Table {
+    int version;
+    int payload[15];
+};
+
+class MutexSharedPtr {
+public:
+    explicit MutexSharedPtr(SharedPtr<Table> value) : value_(std::move(value)) {
+    }
+
+    SharedPtr<Table> Load() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return value_;
+    }
+
+    void Store(SharedPtr<Table> value) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        value_.Swap(value);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    SharedPtr<Table> value_;
+};
+
+template <typename Holder>
+double Measure(size_t readers) {
+    Holder holder(MakeShared<Table>(Table{0, {}}));
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int version = 1; !done.load(std::memory_order_relaxed); ++version) {
+            holder.Store(MakeShared<Table>(Table{version, {}}));
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    double ops = bench::RunThreads(readers, std::chrono::milliseconds(300), [&](size_t) {
+        auto table = holder.Load();
+        bench::DoNotOptimize(table->version);
+    });
+    done.store(true, std::memory_order_relaxed);
+    writer.join();
+    return ops;
+}
+
+}  // namespace
+
+int main() {
+    size_t max_readers = std::max(2u, std::thread::hardware_concurrency());
+    std::printf("%8s %20s %20s\n", "readers", "atomic Mops/s", "mutex Mops/s");
+    for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+        double atomic = Measure<AtomicSharedPtr<Table>>(readers);
+        double mutex = Measure<MutexSharedPtr>(readers);
+        std::printf("%8zu %20.2f %20.2f\n", readers, atomic / 1e6, mutex / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tiny hand-rolled benchmark harness, no dependencies beyond the standard library.
+// Benchmarks are single translation units, e.g.
+//     g++ -O2 -std=c++17 -pthread -I. bench/atomic_shared_bench.cpp -o atomic_shared_bench
+
+namespace bench {
+
+// Keeps the optimizer from throwing away the measured work
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Global `operator new` calls and bytes requested, see the replacements at the bottom
+inline std::atomic<size_t> allocations{0};
+inline std::atomic<size_t> allocated_bytes{0};
+// Bytes currently allocated through the global `operator new`
+inline std::atomic<size_t> live_bytes{0};
+inline constexpr size_t kSizePrefix = alignof(std::max_align_t);
+
+// Runs `body(thread_index)` on `threads` threads for roughly `duration`; each call counts as
+// one operation. Returns the aggregate throughput in operations per second.
+template <typename Body>
+double RunThreads(size_t threads, std::chrono::milliseconds duration, Body body) {
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::vector<size_t> ops(threads, 0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            while (!start.load(std::memory_order_acquire)) {
+            }
+            size_t done = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                body(i);
+                ++done;
+            }
+            ops[i] = done;
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    size_t total = 0;
+    for (size_t done : ops) {
+        total += done;
+    }
+    return total / elapsed.count();
+}
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    double allocations_per_op;
+};
+
+// Runs `body()` in doubling batches until one batch takes at least `min_time`
+template <typename Body>
+Result Measure(std::string name, Body body,
+               std::chrono::milliseconds min_time = std::chrono::milliseconds(200)) {
+    for (size_t iterations = 1;; iterations *= 2) {
+        size_t allocations_before = allocations.load(std::memory_order_relaxed);
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - begin;
+        size_t allocated = allocations.load(std::memory_order_relaxed) - allocations_before;
+        if (elapsed >= min_time || iterations >= (size_t{1} << 32)) {
+            return {std::move(name), elapsed.count() / iterations,
+                    static_cast<double>(allocated) / iterations};
+        }
+    }
+}
+
+inline void PrintTable(const std::vector<Result>& results) {
+    std::printf("%-40s %12s %12s\n", "benchmark", "ns/op", "allocs/op");
+    for (const auto& result : results) {
+        std::printf("%-40s %12.2f %12.2f\n", result.name.c_str(), result.ns_per_op,
+                    result.allocations_per_op);
+    }
+}
+
+// Names are plain identifiers, so nothing needs escaping
+inline void PrintJson(const std::vector<Result>& results) {
+    std::printf("{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::printf("    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f}%s\n",
+                    results[i].name.c_str(), results[i].ns_per_op,
+                    results[i].allocations_per_op, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+}  // namespace bench
+
+// Counting replacements for the global allocation functions; every benchmark is a single
+// translation unit, so defining them in this header is fine. Each allocation is prefixed with
+// its size so that `live_bytes` can be kept exact.
+namespace bench {
+
+// Hides where a pointer came from, so that the compiler does not flag the prefix arithmetic
+// around an inlined `new`/`delete` pair as out of bounds or mismatched
+inline void* Launder(void* ptr) {
+    asm volatile("" : "+r"(ptr));
+    return ptr;
+}
+
+// `prefix` bytes in front of the returned pointer, the last `size_t` of them holding `size`
+inline void* TrackedAllocate(size_t size, size_t prefix, size_t alignment) {
+    size_t total = prefix + size;
+    void* base = alignment <= alignof(std::max_align_t)
+                     ? std::malloc(total)
+                     : std::aligned_alloc(alignment, (total + alignment - 1) & ~(alignment - 1));
+    if (!base) {
+        throw std::bad_alloc();
+    }
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    live_bytes.fetch_add(size, std::memory_order_relaxed);
+    char* ptr = static_cast<char*>(Launder(base)) + prefix;
+    *reinterpret_cast<size_t*>(ptr - sizeof(size_t)) = size;
+    return ptr;
+}
+
+inline void TrackedFree(void* ptr, size_t prefix) noexcept {
+    if (!ptr) {
+        return;
+    }
+    char* user = static_cast<char*>(Launder(ptr));
+    live_bytes.fetch_sub(*reinterpret_cast<size_t*>(user - sizeof(size_t)),
+                         std::memory_order_relaxed);
+    std::free(user - prefix);
+}
+
+// Over-aligned allocations keep the pointer aligned by using a whole alignment unit as prefix
+inline size_t AlignedPrefix(std::align_val_t alignment) {
+    auto align = static_cast<size_t>(alignment);
+    return align < kSizePrefix ? kSizePrefix : align;
+}
+
+}  // namespace bench
+
+void* operator new(size_t size) {
+    return bench::TrackedAllocate(size, bench::kSizePrefix, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return bench::TrackedAllocate(size, bench::AlignedPrefix(alignment),
+                                  static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+    bench::TrackedFree(ptr, bench::kSizePrefix);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    bench::TrackedFree(ptr, bench::kSizePrefix);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+    bench::TrackedFree(ptr, bench::AlignedPrefix(alignment));
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept {
+    bench::TrackedFree(ptr, bench::AlignedPrefix(alignment));
+}
@@ -0,0 +1,57 @@
+// A container of many shared pointers: bytes per entry (the vector's own slots and everything
+// they own) and the time to walk it, for the two-word `SharedPtr` versus the one-word
+// `CompactSharedPtr`. The smaller entries are certain; the walk is not reliably faster: on a
+// 1-CPU Xeon VM it took 3-11% less time than `SharedPtr`'s over repeated runs, elsewhere it has
+// been slower, so measure on the target machine before counting on it.
+
+#include "compact_shared.h"
+#include "bench/bench.h"
+
+#include <cstdint>
+#include <string>
+
+namespace {
+
+constexpr size_t kEntries = 1 << 20;
+
+struct Node {
+    int64_t value;
+};
+
+template <typename Pointer, typename Make>
+void Run(const char* name, Make make, std::vector<bench::Result>& results) {
+    size_t before = bench::live_bytes.load(std::memory_order_relaxed);
+    std::vector<Pointer> nodes;
+    nodes.reserve(kEntries);
+    for (size_t i = 0; i < kEntries; ++i) {
+        nodes.push_back(make(static_cast<int64_t>(i)));
+    }
+    size_t after = bench::live_bytes.load(std::memory_order_relaxed);
+    std::printf("%-40s %12zu %12.1f\n", name, sizeof(Pointer),
+                static_cast<double>(after - before) / kEntries);
+
+    results.push_back(bench::Measure(std::string(name) + "_iterate", [&] {
+        int64_t sum = 0;
+        for (const auto& node : nodes) {
+            sum += node->value;
+        }
+        bench::DoNotOptimize(sum);
+    }));
+    results.push_back(bench::Measure(std::string(name) + "_copy_container", [&] {
+        auto copy = nodes;
+        bench::DoNotOptimize(copy);
+    }));
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%-40s %12s %12s\n", "pointer", "sizeof", "bytes/entry");
+    std::vector<bench::Result> results;
+    Run<SharedPtr<Node>>("SharedPtr", [](int64_t i) { return MakeShared<Node>(Node{i}); },
+                         results);
+    Run<CompactSharedPtr<Node>>(
+        "CompactSharedPtr", [](int64_t i) { return MakeCompactShared<Node>(Node{i}); }, results);
+    std::printf("\n");
+    bench::PrintTable(results);
+}
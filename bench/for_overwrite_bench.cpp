@@ -0,0 +1,54 @@
+// Cost of getting a large I/O buffer that is overwritten right away (a `memcpy` standing in for
+// `read()`): value-initializing factories zero every page first and then write it again, the
+// `ForOverwrite` ones leave the first touch to the copy. 256 KiB buffers are recycled by the
+// allocator, so skipping the zeroing halves the memory traffic. 64 MiB ones are fresh pages every
+// time, which the kernel faults in and zeroes either way; only the extra pass is saved there.
+
+#include "shared.h"
+#include "unique.h"
+#include "bench/bench.h"
+
+#include <cstring>
+
+namespace {
+
+template <size_t Size>
+void RunSize(const char* size_name) {
+    static std::vector<char> source(Size, 'x');
+    auto read = [](char* buffer) {
+        std::memcpy(buffer, source.data(), Size);
+        bench::DoNotOptimize(buffer[Size - 1]);
+    };
+
+    std::vector<bench::Result> results;
+    results.push_back(bench::Measure("UniquePtr_new_value_init", [&] {
+        UniquePtr<char[]> buffer(new char[Size]());
+        read(buffer.Get());
+    }));
+    results.push_back(bench::Measure("MakeUnique", [&] {
+        auto buffer = MakeUnique<char[]>(Size);
+        read(buffer.Get());
+    }));
+    results.push_back(bench::Measure("MakeUniqueForOverwrite", [&] {
+        auto buffer = MakeUniqueForOverwrite<char[]>(Size);
+        read(buffer.Get());
+    }));
+    results.push_back(bench::Measure("MakeShared", [&] {
+        auto buffer = MakeShared<char[]>(Size);
+        read(buffer.Get());
+    }));
+    results.push_back(bench::Measure("MakeSharedForOverwrite", [&] {
+        auto buffer = MakeSharedForOverwrite<char[]>(Size);
+        read(buffer.Get());
+    }));
+    std::printf("%s buffer\n", size_name);
+    bench::PrintTable(results);
+    std::printf("\n");
+}
+
+}  // namespace
+
+int main() {
+    RunSize<256 * 1024>("256 KiB");
+    RunSize<64 * 1024 * 1024>("64 MiB");
+}
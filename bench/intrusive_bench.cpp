@@ -0,0 +1,67 @@
+// Graph-node memory and copy throughput: `IntrusivePtr` + `IntrusiveRefCounted` versus
+// `MakeShared`.
+
+#include "intrusive.h"
+#include "shared.h"
+#include "bench/bench.h"
+
+namespace {
+
+constexpr size_t kNodes = 1'000'000;
+
+struct SharedNode {
+    int value;
+    SharedPtr<SharedNode> next;
+};
+
+struct IntrusiveNode : IntrusiveRefCounted<IntrusiveNode> {
+    explicit IntrusiveNode(int v) : value(v) {
+    }
+
+    int value;
+    IntrusivePtr<IntrusiveNode> next;
+};
+
+template <typename Ptr, typename Make>
+void Measure(const char* name, Make make) {
+    size_t bytes_before = bench::allocated_bytes.load();
+    std::vector<Ptr> nodes;
+    nodes.reserve(kNodes);
+    size_t vector_bytes = bench::allocated_bytes.load() - bytes_before;
+    for (size_t i = 0; i < kNodes; ++i) {
+        nodes.push_back(make(static_cast<int>(i)));
+        if (i > 0) {
+            nodes[i]->next = nodes[i - 1];
+        }
+    }
+    size_t node_bytes = bench::allocated_bytes.load() - bytes_before - vector_bytes;
+
+    auto begin = std::chrono::steady_clock::now();
+    long sum = 0;
+    for (const auto& node : nodes) {
+        Ptr copy = node;
+        sum += copy->value;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    bench::DoNotOptimize(sum);
+
+    // Unlink iteratively so the chain is not destroyed recursively
+    for (auto& node : nodes) {
+        node->next = Ptr();
+    }
+    std::printf("%-12s %10zu %14.1f %14.2f\n", name, sizeof(Ptr),
+                static_cast<double>(node_bytes) / kNodes, elapsed.count() / kNodes);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%-12s %10s %14s %14s\n", "pointer", "sizeof", "bytes/node", "ns/copy");
+    Measure<SharedPtr<SharedNode>>("SharedPtr", [](int i) {
+        return MakeShared<SharedNode>(SharedNode{i, {}});
+    });
+    Measure<IntrusivePtr<IntrusiveNode>>("IntrusivePtr", [](int i) {
+        return MakeIntrusive<IntrusiveNode>(i);
+    });
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Counter operations and time per move: every move-like operation on `SharedPtr` should leave
+// the control block alone. A counting policy records each counter access.
+
+#include "shared.h"
+#include "weak.h"
+#include "bench/bench.h"
+
+namespace {
+
+size_t counter_ops = 0;
+
+class CountingRefCount : public SingleThreadedRefCount {
+public:
+    void AddRef() noexcept {
+        ++counter_ops;
+        SingleThreadedRefCount::AddRef();
+    }
+
+    bool TryAddRef() noexcept {
+        ++counter_ops;
+        return SingleThreadedRefCount::TryAddRef();
+    }
+
+    bool ReleaseRef() noexcept {
+        ++counter_ops;
+        return SingleThreadedRefCount::ReleaseRef();
+    }
+
+    void AddWeak() noexcept {
+        ++counter_ops;
+        SingleThreadedRefCount::AddWeak();
+    }
+
+    bool ReleaseWeak() noexcept {
+        ++counter_ops;
+        return SingleThreadedRefCount::ReleaseWeak();
+    }
+};
+
+struct Base {
+    virtual ~Base() = default;
+    int value = 1;
+};
+
+struct Derived : Base {};
+
+template <typename T>
+using Ptr = SharedPtr<T, CountingRefCount>;
+
+constexpr size_t kIterations = 10'000'000;
+
+// `step` moves the pointer out of `from` and back; reports counter ops and ns per move
+template <typename Step>
+void Measure(const char* name, Step step) {
+    auto from = MakeShared<Derived, CountingRefCount>();
+    counter_ops = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; ++i) {
+        step(from);
+        bench::DoNotOptimize(from);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    std::printf("%-24s %12.2f %10.2f\n", name, static_cast<double>(counter_ops) / kIterations / 2,
+                elapsed.count() / kIterations / 2);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%-24s %12s %10s\n", "operation", "ops/move", "ns/move");
+    Measure("copy (reference)", [](Ptr<Derived>& from) {
+        Ptr<Derived> to(from);
+        Ptr<Derived> back(to);
+    });
+    Measure("move construct", [](Ptr<Derived>& from) {
+        Ptr<Derived> to(std::move(from));
+        from = Ptr<Derived>(std::move(to));
+    });
+    Measure("move assign", [](Ptr<Derived>& from) {
+        Ptr<Derived> to;
+        to = std::move(from);
+        from = std::move(to);
+    });
+    Measure("converting move", [](Ptr<Derived>& from) {
+        Ptr<Base> to(std::move(from));
+        from = StaticPointerCast<Derived>(std::move(to));
+    });
+    Measure("aliasing move", [](Ptr<Derived>& from) {
+        Derived* raw = from.Get();
+        Ptr<Base> to(std::move(from), raw);
+        from = Ptr<Derived>(std::move(to), raw);
+    });
+    Measure("dynamic cast move", [](Ptr<Derived>& from) {
+        Ptr<Base> to = DynamicPointerCast<Base>(std::move(from));
+        from = DynamicPointerCast<Derived>(std::move(to));
+    });
+    Measure("const cast move", [](Ptr<Derived>& from) {
+        Ptr<const Derived> to = ConstPointerCast<const Derived>(std::move(from));
+        from = ConstPointerCast<Derived>(std::move(to));
+    });
+    return 0;
+}
@@ -0,0 +1,39 @@
+// Many-core contention: every thread keeps copying and dropping one global object, through a
+// plain `SharedPtr` (one counter for all cores) and through `ShardedSharedPtr` (one counter per
+// thread slot).
+
+#include "shared.h"
+#include "sharded_shared.h"
+#include "bench/bench.h"
+
+#include <algorithm>
+
+namespace {
+
+struct Schema {
+    int version;
+    int fields[15];
+};
+
+template <typename Ptr>
+double Measure(const Ptr& global, size_t threads) {
+    return bench::RunThreads(threads, std::chrono::milliseconds(300), [&](size_t) {
+        Ptr copy = global;
+        bench::DoNotOptimize(copy->version);
+    });
+}
+
+}  // namespace
+
+int main() {
+    auto shared = MakeShared<Schema>(Schema{1, {}});
+    auto sharded = MakeShardedShared<Schema>(Schema{1, {}});
+    size_t max_threads = std::max(2u, std::thread::hardware_concurrency());
+    std::printf("%8s %20s %20s\n", "threads", "SharedPtr Mops/s", "sharded Mops/s");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double plain = Measure(shared, threads);
+        double split = Measure(sharded, threads);
+        std::printf("%8zu %20.2f %20.2f\n", threads, plain / 1e6, split / 1e6);
+    }
+    return 0;
+}
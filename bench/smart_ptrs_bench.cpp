@@ -0,0 +1,134 @@
+// Regression suite: every basic operation of shared.h, weak.h and unique.h next to its standard
+// library counterpart. Prints a table, or JSON with `--json`.
+
+#include "local_shared.h"
+#include "pool_allocator.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+#include "bench/bench.h"
+
+#include <cstring>
+#include <memory>
+
+namespace {
+
+struct Widget : EnableSharedFromThis<Widget> {
+    int value = 1;
+};
+
+struct StdWidget : std::enable_shared_from_this<StdWidget> {
+    int value = 1;
+};
+
+// Stateful, so it takes space next to the pointer
+class CountingDeleter {
+public:
+    CountingDeleter() = default;
+    explicit CountingDeleter(size_t* deleted) : deleted_(deleted) {
+    }
+
+    void operator()(int* ptr) {
+        ++*deleted_;
+        delete ptr;
+    }
+
+private:
+    size_t* deleted_{nullptr};
+};
+
+std::vector<bench::Result> RunAll() {
+    std::vector<bench::Result> results;
+
+    results.push_back(bench::Measure("MakeShared", [] {
+        auto sp = MakeShared<int>(1);
+        bench::DoNotOptimize(sp);
+    }));
+    results.push_back(bench::Measure("std_make_shared", [] {
+        auto sp = std::make_shared<int>(1);
+        bench::DoNotOptimize(sp);
+    }));
+    results.push_back(bench::Measure("MakeShared_packed", [] {
+        auto sp = MakeShared<int, PackedRefCount>(1);
+        bench::DoNotOptimize(sp);
+    }));
+
+    results.push_back(bench::Measure("AllocateShared_PoolAllocator", [] {
+        auto sp = AllocateShared<int>(PoolAllocator<int>(), 1);
+        bench::DoNotOptimize(sp);
+    }));
+    results.push_back(bench::Measure("std_allocate_shared_PoolAllocator", [] {
+        auto sp = std::allocate_shared<int>(PoolAllocator<int>(), 1);
+        bench::DoNotOptimize(sp);
+    }));
+
+    auto shared = MakeShared<int>(1);
+    results.push_back(bench::Measure("SharedPtr_copy", [&] {
+        SharedPtr<int> copy(shared);
+        bench::DoNotOptimize(copy);
+    }));
+    auto std_shared = std::make_shared<int>(1);
+    results.push_back(bench::Measure("std_shared_ptr_copy", [&] {
+        std::shared_ptr<int> copy(std_shared);
+        bench::DoNotOptimize(copy);
+    }));
+
+    auto single = MakeShared<int, SingleThreadedRefCount>(1);
+    results.push_back(bench::Measure("SharedPtr_copy_single_threaded", [&] {
+        SharedPtr<int, SingleThreadedRefCount> copy(single);
+        bench::DoNotOptimize(copy);
+    }));
+
+    auto local = MakeLocalShared<int>(1);
+    results.push_back(bench::Measure("LocalSharedPtr_copy", [&] {
+        LocalSharedPtr<int> copy(local);
+        bench::DoNotOptimize(copy);
+    }));
+
+    WeakPtr<int> weak(shared);
+    results.push_back(bench::Measure("WeakPtr_Lock", [&] {
+        auto locked = weak.Lock();
+        bench::DoNotOptimize(locked);
+    }));
+    std::weak_ptr<int> std_weak(std_shared);
+    results.push_back(bench::Measure("std_weak_ptr_lock", [&] {
+        auto locked = std_weak.lock();
+        bench::DoNotOptimize(locked);
+    }));
+
+    size_t deleted = 0;
+    results.push_back(bench::Measure("UniquePtr_stateful_deleter", [&] {
+        UniquePtr<int, CountingDeleter> up(new int(1), CountingDeleter(&deleted));
+        bench::DoNotOptimize(up);
+    }));
+    results.push_back(bench::Measure("std_unique_ptr_stateful_deleter", [&] {
+        std::unique_ptr<int, CountingDeleter> up(new int(1), CountingDeleter(&deleted));
+        bench::DoNotOptimize(up);
+    }));
+    bench::DoNotOptimize(deleted);
+
+    auto widget = MakeShared<Widget>();
+    results.push_back(bench::Measure("SharedFromThis", [&] {
+        auto self = widget->SharedFromThis();
+        bench::DoNotOptimize(self);
+    }));
+    auto std_widget = std::make_shared<StdWidget>();
+    results.push_back(bench::Measure("std_shared_from_this", [&] {
+        auto self = std_widget->shared_from_this();
+        bench::DoNotOptimize(self);
+    }));
+
+    return results;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    auto results = RunAll();
+    if (argc > 1 && std::strcmp(argv[1], "--json") == 0) {
+        bench::PrintJson(results);
+    } else {
+        bench::PrintTable(results);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Reader scalability of a short lookup in the current snapshot of a table: `SharedSnapshot`
+// (epoch-protected raw view, no counter writes) versus `AtomicSharedPtr::Load` (one counted
+// `SharedPtr` per lookup), with one writer republishing the table in the background.
+
+#include "atomic_shared.h"
+#include "shared_snapshot.h"
+#include "bench/bench.h"
+
+#include <algorithm>
+
+namespace {
+
+struct Table {
+    int version;
+    int payload[15];
+};
+
+template <typename Publish, typename Lookup>
+double Measure(size_t readers, Publish publish, Lookup lookup) {
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int version = 1; !done.load(std::memory_order_relaxed); ++version) {
+            publish(MakeShared<Table>(Table{version, {}}));
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    double ops = bench::RunThreads(readers, std::chrono::milliseconds(300), [&](size_t) {
+        lookup();
+    });
+    done.store(true, std::memory_order_relaxed);
+    writer.join();
+    return ops;
+}
+
+}  // namespace
+
+int main() {
+    SharedSnapshot<Table> snapshot(MakeShared<Table>(Table{0, {}}));
+    AtomicSharedPtr<Table> atomic(MakeShared<Table>(Table{0, {}}));
+    size_t max_readers = std::max(2u, std::thread::hardware_concurrency());
+    std::printf("%8s %20s %20s\n", "readers", "snapshot Mops/s", "atomic Mops/s");
+    for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+        double epochs = Measure(
+            readers, [&](SharedPtr<Table> table) { snapshot.Publish(std::move(table)); },
+            [&] {
+                auto table = snapshot.Read();
+                bench::DoNotOptimize(table->payload[table->version % 15]);
+            });
+        double counted = Measure(
+            readers, [&](SharedPtr<Table> table) { atomic.Store(std::move(table)); },
+            [&] {
+                auto table = atomic.Load();
+                bench::DoNotOptimize(table->payload[table->version % 15]);
+            });
+        std::printf("%8zu %20.2f %20.2f\n", readers, epochs / 1e6, counted / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Memory kept alive by `WeakPtr`s after the last strong reference is gone: with the embedded
+// layout (`AllocateShared`, `std::make_shared`) the whole object stays allocated, with the split
+// layout (`MakeSharedSplit`, and `MakeShared` for large types) only the control block does.
+
+#include "shared.h"
+#include "weak.h"
+#include "bench/bench.h"
+
+#include <memory>
+
+namespace {
+
+constexpr size_t kEntries = 1000;
+
+template <size_t Size>
+struct Entry {
+    char payload[Size];
+};
+
+// Builds `kEntries` objects with `make`, keeps a weak reference to each and drops the strong
+// ones; returns the bytes still allocated per entry
+template <typename Weak, typename Make>
+double BytesHeldPerEntry(Make make) {
+    std::vector<Weak> weak;
+    weak.reserve(kEntries);
+    size_t before = bench::live_bytes.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kEntries; ++i) {
+        auto sp = make();
+        weak.emplace_back(sp);
+    }
+    size_t after = bench::live_bytes.load(std::memory_order_relaxed);
+    return static_cast<double>(after - before) / kEntries;
+}
+
+template <size_t Size>
+void RunSize(const char* size_name) {
+    using Big = Entry<Size>;
+    struct Row {
+        const char* layout;
+        double bytes;
+    };
+    Row rows[] = {
+        {"AllocateShared (embedded)", BytesHeldPerEntry<WeakPtr<Big>>([] {
+             return AllocateShared<Big>(std::allocator<Big>());
+         })},
+        {"MakeSharedSplit (split)", BytesHeldPerEntry<WeakPtr<Big>>([] {
+             return MakeSharedSplit<Big>();
+         })},
+        {"MakeShared", BytesHeldPerEntry<WeakPtr<Big>>([] { return MakeShared<Big>(); })},
+        {"std::make_shared", BytesHeldPerEntry<std::weak_ptr<Big>>([] {
+             return std::make_shared<Big>();
+         })},
+    };
+    std::printf("%s object, %zu entries, only WeakPtrs left\n", size_name, kEntries);
+    std::printf("  %-28s %16s\n", "layout", "bytes/entry");
+    for (const auto& row : rows) {
+        std::printf("  %-28s %16.0f\n", row.layout, row.bytes);
+    }
+
+    std::vector<bench::Result> results;
+    results.push_back(bench::Measure("embedded_create_destroy", [] {
+        auto sp = AllocateShared<Big>(std::allocator<Big>());
+        bench::DoNotOptimize(sp);
+    }));
+    results.push_back(bench::Measure("split_create_destroy", [] {
+        auto sp = MakeSharedSplit<Big>();
+        bench::DoNotOptimize(sp);
+    }));
+    bench::PrintTable(results);
+    std::printf("\n");
+}
+
+}  // namespace
+
+int main() {
+    RunSize<64>("64 B");
+    RunSize<4096>("4 KiB");
+    RunSize<64 * 1024>("64 KiB");
+}
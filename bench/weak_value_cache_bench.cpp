@@ -0,0 +1,78 @@
+// Interning throughput with many threads: `WeakValueCache` (striped locks, incremental purging)
+// versus one mutex around an `std::unordered_map` of `WeakPtr`s that is swept completely every
+// `kSweepEvery` insertions. Each thread keeps a small window of the values it got, so entries
+// keep expiring and being recreated.
+
+#include "weak_value_cache.h"
+#include "bench/bench.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t kKeys = 1 << 17;
+constexpr size_t kWindow = 64;
+constexpr size_t kSweepEvery = 1024;
+
+class GlobalLockCache {
+public:
+    SharedPtr<std::string> Intern(const std::string& key) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto& entry = map_[key];
+        if (auto value = entry.Lock()) {
+            return value;
+        }
+        auto value = MakeShared<std::string>(key);
+        entry = value;
+        if (++inserts_ % kSweepEvery == 0) {
+            for (auto it = map_.begin(); it != map_.end();) {
+                it = it->second.Expired() ? map_.erase(it) : std::next(it);
+            }
+        }
+        return value;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, WeakPtr<std::string>> map_;
+    size_t inserts_{0};
+};
+
+std::vector<std::string> MakeKeys() {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < kKeys; ++i) {
+        keys.push_back("schema/" + std::to_string(i * 2654435761u));
+    }
+    return keys;
+}
+
+template <typename Cache>
+double Measure(size_t threads, const std::vector<std::string>& keys) {
+    Cache cache;
+    std::vector<std::vector<SharedPtr<std::string>>> windows(threads);
+    std::vector<size_t> next(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        windows[i].resize(kWindow);
+        next[i] = i * 7919;
+    }
+    return bench::RunThreads(threads, std::chrono::milliseconds(300), [&](size_t thread) {
+        size_t n = next[thread]++;
+        windows[thread][n % kWindow] = cache.Intern(keys[(n * 40503u) % kKeys]);
+    });
+}
+
+}  // namespace
+
+int main() {
+    auto keys = MakeKeys();
+    size_t max_threads = std::max(2u, std::thread::hardware_concurrency());
+    std::printf("%8s %20s %20s\n", "threads", "striped Mops/s", "global lock Mops/s");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double striped = Measure<WeakValueCache<std::string, std::string>>(threads, keys);
+        double global = Measure<GlobalLockCache>(threads, keys);
+        std::printf("%8zu %20.2f %20.2f\n", threads, striped / 1e6, global / 1e6);
+    }
+    return 0;
+}
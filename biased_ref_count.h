@@ -0,0 +1,237 @@
+#pragma once
+
+#include "sw_fwd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Biased reference counting: a counting policy for objects that are mostly copied on the
+// thread that created them,
+//     auto sp = MakeShared<Session, BiasedRefCount>(args...);
+//
+// The creating (owner) thread counts in `biased_counter_` with plain loads and stores, so its
+// copies and releases cost the same as `SingleThreadedRefCount`. Every other thread counts in
+// `shared_counter_` atomically; that count may go negative when an owner-made copy dies on
+// another thread. Once the owner's count drops to zero it merges both counts and from then on
+// everybody uses the shared one.
+//
+// If another thread pushes the shared count below zero, the true total may already be zero while
+// the owner still holds a (stale) positive biased count. Such blocks are queued to the owner,
+// which merges them in `ProcessQueue`, when it creates a new biased block, or when it exits; only
+// then is the object destroyed. Call `BiasedRefCount::ProcessQueue()` periodically from
+// long-lived owner threads (e.g. once per event loop iteration). Until the merge, `WeakPtr::Lock`
+// from another thread may still succeed on such an object.
+class BiasedRefCount {
+    // Per-thread record shared by all blocks the thread owns; lives until the thread has exited
+    // and every such block is gone
+    struct Owner {
+        std::mutex mutex;
+        BiasedRefCount* queue_head{nullptr};
+        bool exited{false};
+        std::atomic<bool> has_queued{false};
+        std::atomic<size_t> refs{1};
+
+        void Release() noexcept {
+            if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+    };
+
+    // Blocks created after the thread's record is gone start out merged
+    struct OwnerHolder {
+        OwnerHolder() {
+            current = owner;
+        }
+
+        ~OwnerHolder() {
+            current = nullptr;
+            exited = true;
+            Drain(owner, true);
+            owner->Release();
+        }
+
+        Owner* owner{new Owner};
+        inline static thread_local Owner* current{nullptr};
+        inline static thread_local bool exited{false};
+    };
+
+    // The shared counter keeps the strong count in the upper bits, the "merged" flag in bit 0
+    // and the "queued to the owner" flag in bit 1
+    static constexpr int64_t kMerged = 1;
+    static constexpr int64_t kQueued = 2;
+    static constexpr int64_t kOneRef = 4;
+    static constexpr int kCountShift = 2;
+
+public:
+    BiasedRefCount() noexcept : owner_(CurrentOwner()) {
+        if (!owner_) {
+            merged_ = true;
+            biased_counter_.store(0, std::memory_order_relaxed);
+            shared_counter_.store(kOneRef | kMerged, std::memory_order_relaxed);
+            return;
+        }
+        owner_->refs.fetch_add(1, std::memory_order_relaxed);
+        if (owner_->has_queued.load(std::memory_order_relaxed)) {
+            Drain(owner_, false);
+        }
+    }
+
+    // Merges every block the other threads queued to the calling thread
+    static void ProcessQueue() noexcept {
+        if (Owner* owner = CurrentOwner()) {
+            Drain(owner, false);
+        }
+    }
+
+    void AddRef() noexcept {
+        if (IsOwnerThread()) {
+            auto count = biased_counter_.load(std::memory_order_relaxed);
+            biased_counter_.store(count + 1, std::memory_order_relaxed);
+        } else {
+            shared_counter_.fetch_add(kOneRef, std::memory_order_relaxed);
+        }
+    }
+
+    bool TryAddRef() noexcept {
+        if (IsOwnerThread()) {
+            // Not merged yet, so the owner still holds a reference
+            AddRef();
+            return true;
+        }
+        int64_t shared = shared_counter_.load(std::memory_order_relaxed);
+        while (!(shared & kMerged) || (shared >> kCountShift) > 0) {
+            if (shared_counter_.compare_exchange_weak(shared, shared + kOneRef,
+                                                      std::memory_order_acq_rel,
+                                                      std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReleaseRef() noexcept {
+        if (IsOwnerThread()) {
+            auto count = biased_counter_.load(std::memory_order_relaxed) - 1;
+            biased_counter_.store(count, std::memory_order_relaxed);
+            return count == 0 && Merge();
+        }
+        // The first thread to take the unmerged count below zero queues the block; it pins the
+        // block with a weak reference before the decrement makes that necessary
+        bool pinned = false;
+        int64_t shared = shared_counter_.load(std::memory_order_relaxed);
+        while (true) {
+            int64_t next = shared - kOneRef;
+            bool queue = !(shared & (kMerged | kQueued)) && (next >> kCountShift) < 0;
+            if (queue) {
+                if (!pinned) {
+                    AddWeak();
+                    pinned = true;
+                }
+                next |= kQueued;
+            }
+            if (shared_counter_.compare_exchange_weak(shared, next, std::memory_order_acq_rel,
+                                                      std::memory_order_relaxed)) {
+                if (queue) {
+                    return QueueToOwner();
+                }
+                if (pinned) {
+                    // The strong owners still hold their weak reference, so it is never the last
+                    weak_counter_.fetch_sub(1, std::memory_order_relaxed);
+                }
+                return (next & kMerged) && (next >> kCountShift) == 0;
+            }
+        }
+    }
+
+    void AddWeak() noexcept {
+        weak_counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool ReleaseWeak() noexcept {
+        if (weak_counter_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return false;
+        }
+        if (owner_) {
+            owner_->Release();
+        }
+        return true;
+    }
+
+    // Approximate while other threads are copying
+    size_t UseCount() const noexcept {
+        int64_t shared = shared_counter_.load(std::memory_order_relaxed) >> kCountShift;
+        return shared + biased_counter_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using Block = ControlBlockBase<BiasedRefCount>;
+
+    static Owner* CurrentOwner() noexcept {
+        if (!OwnerHolder::current && !OwnerHolder::exited) {
+            thread_local OwnerHolder holder;
+        }
+        return OwnerHolder::current;
+    }
+
+    // Other threads never look at `merged_`, only the owner writes it while it is alive
+    bool IsOwnerThread() const noexcept {
+        return owner_ == OwnerHolder::current && !merged_;
+    }
+
+    // Folds the biased count into the shared one; only the owner (or anyone, once the owner has
+    // exited) may call it. Returns true if no references are left.
+    bool Merge() noexcept {
+        merged_ = true;
+        auto biased = biased_counter_.load(std::memory_order_relaxed);
+        biased_counter_.store(0, std::memory_order_relaxed);
+        int64_t shared = shared_counter_.fetch_add(biased * kOneRef + kMerged,
+                                                   std::memory_order_acq_rel);
+        return (shared >> kCountShift) + biased == 0;
+    }
+
+    // Hands the pinned block to the owner. Returns true if the owner is gone and the merge done
+    // here released the last reference.
+    bool QueueToOwner() noexcept {
+        {
+            std::lock_guard<std::mutex> guard(owner_->mutex);
+            if (!owner_->exited) {
+                next_queued_ = owner_->queue_head;
+                owner_->queue_head = this;
+                owner_->has_queued.store(true, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        weak_counter_.fetch_sub(1, std::memory_order_relaxed);
+        return Merge();
+    }
+
+    static void Drain(Owner* owner, bool exiting) noexcept {
+        BiasedRefCount* queued = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(owner->mutex);
+            queued = owner->queue_head;
+            owner->queue_head = nullptr;
+            owner->has_queued.store(false, std::memory_order_relaxed);
+            owner->exited = exiting;
+        }
+        while (queued) {
+            BiasedRefCount* next = queued->next_queued_;
+            auto block = static_cast<Block*>(queued);
+            if (!queued->merged_ && queued->Merge()) {
+                block->DestroyObject();
+            }
+            block->DecWeak();
+            queued = next;
+        }
+    }
+
+    std::atomic<uint32_t> biased_counter_{1};
+    std::atomic<uint32_t> weak_counter_{1};
+    std::atomic<int64_t> shared_counter_{0};
+    Owner* owner_;
+    BiasedRefCount* next_queued_{nullptr};
+    bool merged_{false};
+};
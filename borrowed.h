@@ -0,0 +1,98 @@
+#pragma once
+
+#include "shared.h"
+#include "unique.h"
+
+// Non-owning view of an object managed by a `SharedPtr` or a `UniquePtr`, meant for function
+// parameters: creating, copying and destroying it never touches the reference counters.
+//     void Handle(Borrowed<Request> request);
+//     Handle(request_sp);
+// A `WeakPtr` has to be locked into a named `SharedPtr` first; borrowing from a temporary owner
+// does not compile. The owner must outlive every borrow. Define `SMART_PTRS_DEBUG_BORROWS` to
+// have borrows of `SharedPtr`s counted in the control block and checked when the object dies;
+// the check aborts the program, with or without `NDEBUG`.
+template <typename T, typename Policy = DefaultRefCount>
+class Borrowed {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    template <typename U>
+    Borrowed(const SharedPtr<U, Policy>& owner) : ptr_(owner.Get()), block_(owner.block_) {
+        AddBorrow();
+    }
+    template <typename U>
+    Borrowed(const SharedPtr<U, Policy>&& owner) = delete;
+
+    template <typename U, typename Deleter>
+    Borrowed(const UniquePtr<U, Deleter>& owner) : ptr_(owner.Get()) {
+    }
+    template <typename U, typename Deleter>
+    Borrowed(const UniquePtr<U, Deleter>&& owner) = delete;
+
+    Borrowed(const Borrowed& other) : ptr_(other.ptr_), block_(other.block_) {
+        AddBorrow();
+    }
+
+    template <typename U>
+    Borrowed(const Borrowed<U, Policy>& other) : ptr_(other.ptr_), block_(other.block_) {
+        AddBorrow();
+    }
+
+    Borrowed& operator=(const Borrowed& other) {
+        Borrowed copy(other);
+        std::swap(ptr_, copy.ptr_);
+        std::swap(block_, copy.block_);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~Borrowed() {
+#ifdef SMART_PTRS_DEBUG_BORROWS
+        if (block_) {
+            block_->ReleaseBorrow();
+        }
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator*() const {
+        return *ptr_;
+    }
+    T* operator->() const {
+        return ptr_;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    // Shares ownership with the original owner; empty for borrows of a `UniquePtr`
+    SharedPtr<T, Policy> Promote() const {
+        if (!block_) {
+            return SharedPtr<T, Policy>();
+        }
+        return SharedPtr<T, Policy>(ptr_, block_);
+    }
+
+private:
+    void AddBorrow() {
+#ifdef SMART_PTRS_DEBUG_BORROWS
+        if (block_) {
+            block_->AddBorrow();
+        }
+#endif
+    }
+
+    T* ptr_{nullptr};
+    ControlBlockBase<Policy>* block_{nullptr};
+
+    template <typename U, typename P>
+    friend class Borrowed;
+};
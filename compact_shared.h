@@ -0,0 +1,227 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// What a `CompactSharedPtr` (or an `AtomicSharedPtr`) points to when the object does not sit in
+// its control block: a block of its own that remembers the pointer and holds one strong reference
+// on the real owner
+template <typename T, typename Policy>
+class CompactAliasBlock : public ControlBlockBase<Policy> {
+public:
+    CompactAliasBlock(T* ptr, ControlBlockBase<Policy>* owner) noexcept
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<CompactAliasBlock>()),
+          ptr_(ptr),
+          owner_(owner) {
+        this->Created();
+    }
+
+    static void* Manage(ControlBlockBase<Policy>* base, ControlBlockOp op,
+                        const std::type_info*) noexcept {
+        auto self = static_cast<CompactAliasBlock*>(base);
+        if (op == ControlBlockOp::kDestroyObject) {
+            if (self->owner_) {
+                self->owner_->DecRef();
+            }
+            self->owner_ = nullptr;
+        } else if (op == ControlBlockOp::kDeallocate) {
+            delete self;
+        } else if (op == ControlBlockOp::kGetObject) {
+            return ObjectAddress(self->ptr_);
+        }
+        return nullptr;
+    }
+
+    T* ptr_;
+    ControlBlockBase<Policy>* owner_;
+};
+
+// A `SharedPtr` in one word, for containers of many pointers:
+//     std::vector<CompactSharedPtr<Node>> nodes;
+//     nodes.emplace_back(MakeCompactShared<Node>(args...));
+//     SharedPtr<Node> node = nodes[i].ToShared();
+//
+// Only the control block pointer is stored. When the object lives inside its block, as with
+// `MakeShared` of a small object or `MakeCompactShared`, its address is the block's plus a
+// constant, so dereferencing costs no extra load. Anything else (aliased pointers, objects from
+// `new`, `MakeSharedSplit`) gets a `CompactAliasBlock` holding the pointer once, on conversion;
+// the low bit of the word tells the two apart. Copies share either kind of block.
+//
+// There is no `WeakPtr` from a `CompactSharedPtr`; go through `ToShared`.
+template <typename T, typename Policy>
+class CompactSharedPtr {
+    static_assert(!std::is_array_v<T>, "CompactSharedPtr does not support arrays");
+
+    using Block = ControlBlockBase<Policy>;
+    using AliasBlock = CompactAliasBlock<T, Policy>;
+
+    static constexpr uintptr_t kAliasBit = 1;
+    // Where `ControlBlockHolder<T, Policy>` keeps the object; a block with the object anywhere
+    // else is simply never encoded directly
+    static constexpr size_t kObjectOffset =
+        (sizeof(Block) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    CompactSharedPtr() {
+    }
+
+    CompactSharedPtr(std::nullptr_t) {
+    }
+
+    CompactSharedPtr(const CompactSharedPtr& other) : word_(other.word_) {
+        if (word_) {
+            GetBlock()->IncRef();
+        }
+    }
+    CompactSharedPtr(CompactSharedPtr&& other) noexcept : word_(other.word_) {
+        other.word_ = 0;
+    }
+
+    // Allocates a `CompactAliasBlock` unless `other` points into its own block. The rvalue
+    // overload reuses `other`'s reference.
+    explicit CompactSharedPtr(const SharedPtr<T, Policy>& other) {
+        Encode(other.ptr_, other.block_);
+        if (other.block_) {
+            other.block_->IncRef();
+        }
+    }
+    explicit CompactSharedPtr(SharedPtr<T, Policy>&& other) {
+        Encode(other.ptr_, other.block_);
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    CompactSharedPtr& operator=(const CompactSharedPtr& other) {
+        CompactSharedPtr(other).Swap(*this);
+        return *this;
+    }
+    CompactSharedPtr& operator=(CompactSharedPtr&& other) noexcept {
+        CompactSharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~CompactSharedPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() noexcept {
+        if (word_) {
+            GetBlock()->DecRef();
+        }
+        word_ = 0;
+    }
+
+    void Swap(CompactSharedPtr& other) noexcept {
+        std::swap(word_, other.word_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        if (word_ & kAliasBit) {
+            return GetAlias()->ptr_;
+        }
+        if (!word_) {
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(word_ + kObjectOffset);
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    // Every owner of the object: `SharedPtr`s and the `CompactSharedPtr`s of each block
+    size_t UseCount() const {
+        if (!word_) {
+            return 0;
+        }
+        if (word_ & kAliasBit) {
+            AliasBlock* alias = GetAlias();
+            size_t owners = alias->UseCount();
+            return alias->owner_ ? owners + alias->owner_->UseCount() - 1 : owners;
+        }
+        return GetBlock()->UseCount();
+    }
+    explicit operator bool() const {
+        return Get() != nullptr;
+    }
+
+    // The object is not stored in its control block, so the pointer takes an extra load
+    bool IsAliased() const {
+        return word_ & kAliasBit;
+    }
+
+    SharedPtr<T, Policy> ToShared() const {
+        if (word_ & kAliasBit) {
+            return SharedPtr<T, Policy>(GetAlias()->ptr_, GetAlias()->owner_);
+        }
+        return SharedPtr<T, Policy>(Get(), GetBlock());
+    }
+
+private:
+    // Takes over one strong reference on `block` (if any)
+    void Encode(T* ptr, Block* block) {
+        if (!block && !ptr) {
+            return;
+        }
+        auto address = reinterpret_cast<uintptr_t>(block);
+        if (block && reinterpret_cast<uintptr_t>(ptr) == address + kObjectOffset) {
+            assert(!(address & kAliasBit));
+            word_ = address;
+            return;
+        }
+        auto alias = new AliasBlock(ptr, block);
+        word_ = reinterpret_cast<uintptr_t>(static_cast<Block*>(alias)) | kAliasBit;
+    }
+
+    Block* GetBlock() const {
+        return reinterpret_cast<Block*>(word_ & ~kAliasBit);
+    }
+    AliasBlock* GetAlias() const {
+        return static_cast<AliasBlock*>(GetBlock());
+    }
+
+    uintptr_t word_{0};
+};
+
+template <typename T, typename U, typename Policy>
+inline bool operator==(const CompactSharedPtr<T, Policy>& left,
+                       const CompactSharedPtr<U, Policy>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename U, typename Policy>
+inline bool operator!=(const CompactSharedPtr<T, Policy>& left,
+                       const CompactSharedPtr<U, Policy>& right) {
+    return !(left == right);
+}
+
+// Always embeds the object in its block, whatever its size, so the result is never aliased
+template <typename U, typename Policy = DefaultRefCount, typename... Args>
+CompactSharedPtr<U, Policy> MakeCompactShared(Args&&... args) {
+    auto block = new ControlBlockHolder<U, Policy>(std::forward<Args>(args)...);
+    SharedPtr<U, Policy> owner;
+    owner.AdoptBlock(block->GetRawPointer(), block);
+    return CompactSharedPtr<U, Policy>(std::move(owner));
+}
+
+static_assert(sizeof(CompactSharedPtr<int>) == sizeof(void*));
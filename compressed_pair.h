@@ -1,80 +1,152 @@
 #pragma once
 
-#include <type_traits>
 #include <cstddef>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
+// One member of a `CompressedTuple`. Empty non-final types are inherited from instead of
+// stored, so they take no space; `I` keeps two members of the same type apart.
 template <typename T, size_t I, bool EnableEBO = std::is_empty_v<T> && !std::is_final_v<T>>
-struct CompressedPairElement {
-    T value_ = T();
-
-    CompressedPairElement() {
+struct CompressedTupleElement {
+    // Value-initialized, like the members of `std::tuple`
+    constexpr CompressedTupleElement() : value_() {
     }
 
-    CompressedPairElement(T& value) : value_(std::forward<T>(value)){
+    template <typename Tp>
+    constexpr explicit CompressedTupleElement(std::in_place_t, Tp&& value)
+        : value_(std::forward<Tp>(value)) {
     }
 
-    template<typename Tp>
-    CompressedPairElement(Tp&& value) : value_(std::forward<Tp>(value)){
+    template <typename Tuple, size_t... Is>
+    constexpr CompressedTupleElement(std::piecewise_construct_t, Tuple&& args,
+                                     std::index_sequence<Is...>)
+        : value_(std::get<Is>(std::forward<Tuple>(args))...) {
     }
 
-    const T& Get() const {
+    constexpr const T& Get() const noexcept {
         return value_;
     }
 
-    T& Get() {
+    constexpr T& Get() noexcept {
         return value_;
     }
+
+    T value_;
 };
 
 template <typename T, size_t I>
-struct CompressedPairElement<T, I, true> : public T {
-    CompressedPairElement() = default;
+struct CompressedTupleElement<T, I, true> : public T {
+    constexpr CompressedTupleElement() : T() {
+    }
 
-    template<typename Tp>
-    CompressedPairElement(Tp&&) {
+    template <typename Tp>
+    constexpr explicit CompressedTupleElement(std::in_place_t, Tp&& value)
+        : T(std::forward<Tp>(value)) {
     }
 
-    const T& Get() const {
+    template <typename Tuple, size_t... Is>
+    constexpr CompressedTupleElement(std::piecewise_construct_t, Tuple&& args,
+                                     std::index_sequence<Is...>)
+        : T(std::get<Is>(std::forward<Tuple>(args))...) {
+    }
+
+    constexpr const T& Get() const noexcept {
         return *this;
     }
 
-    T& Get() {
+    constexpr T& Get() noexcept {
         return *this;
     }
-    // getters return *this
 };
 
-// Me think, why waste time write lot code, when few code do trick.
-template <typename F, typename S>
-class CompressedPair : private CompressedPairElement<F, 0>, private CompressedPairElement<S, 1> {
-    using First = CompressedPairElement<F, 0>;
-    using Second = CompressedPairElement<S, 1>;
+template <typename Indices, typename... Ts>
+class CompressedTupleStorage;
+
+// Several members of which the empty ones take no space, for what blocks and deleters carry
+// besides the pointer (deleter, allocator, length):
+//     CompressedTuple<T*, Deleter, Alloc> elem(ptr, std::move(deleter), alloc);
+//     elem.Get<1>()(elem.Get<0>());
+// Every member is constructed exactly once, straight from the arguments (forwarded), from a
+// tuple of arguments each (`std::piecewise_construct`), or value-initialized. Copying is
+// trivial when it is for all members, and everything is `constexpr` where the members are.
+template <typename... Ts>
+using CompressedTuple = CompressedTupleStorage<std::index_sequence_for<Ts...>, Ts...>;
+
+template <size_t... Is, typename... Ts>
+class CompressedTupleStorage<std::index_sequence<Is...>, Ts...>
+    : private CompressedTupleElement<Ts, Is>... {
+    template <size_t I>
+    using Element = CompressedTupleElement<std::tuple_element_t<I, std::tuple<Ts...>>, I>;
+
+    // A single argument that is a tuple itself (or a `CompressedPair`) is a copy or a move, not
+    // a member's value
+    template <typename... Us>
+    static constexpr bool kIsSelf =
+        sizeof...(Us) == 1 &&
+        (std::is_base_of_v<CompressedTupleStorage, std::remove_reference_t<Us>> && ...);
 
 public:
-    CompressedPair() = default;
+    constexpr CompressedTupleStorage() = default;
 
-    template <typename Sp>
-    CompressedPair(F& first, Sp&& second) : First(first), Second(std::forward<Sp>(second)) {
+    template <typename... Us,
+              typename = std::enable_if_t<sizeof...(Us) == sizeof...(Ts) && !kIsSelf<Us...>>,
+              typename = std::enable_if_t<(std::is_constructible_v<Ts, Us&&> && ...)>>
+    constexpr CompressedTupleStorage(Us&&... values)
+        : CompressedTupleElement<Ts, Is>(std::in_place, std::forward<Us>(values))... {
     }
 
-    template <typename Sp>
-    CompressedPair(F&& first, Sp&& second) : First(first), Second(std::forward<Sp>(second)) {
+    // Every argument is a tuple of the arguments of one member, e.g. from
+    // `std::forward_as_tuple`; an empty one value-initializes the member
+    template <typename... Tuples, typename = std::enable_if_t<sizeof...(Tuples) == sizeof...(Ts)>>
+    constexpr CompressedTupleStorage(std::piecewise_construct_t, Tuples&&... args)
+        : CompressedTupleElement<Ts, Is>(
+              std::piecewise_construct, std::forward<Tuples>(args),
+              std::make_index_sequence<std::tuple_size_v<std::remove_reference_t<Tuples>>>())... {
     }
 
-    F& GetFirst() {
-        return First::Get();
+    template <size_t I>
+    constexpr auto& Get() noexcept {
+        return Element<I>::Get();
     }
 
-    const F& GetFirst() const {
-        return First::Get();
+    template <size_t I>
+    constexpr const auto& Get() const noexcept {
+        return Element<I>::Get();
     }
+};
 
-    S& GetSecond() {
-        return Second::Get();
+// Me think, why waste time write lot code, when few code do trick.
+template <typename F, typename S>
+class CompressedPair : public CompressedTuple<F, S> {
+public:
+    using CompressedTuple<F, S>::CompressedTuple;
+
+    constexpr F& GetFirst() noexcept {
+        return this->template Get<0>();
+    }
+
+    constexpr const F& GetFirst() const noexcept {
+        return this->template Get<0>();
     }
 
-    const S& GetSecond() const {
-        return Second::Get();
-    };
-};
\ No newline at end of file
+    constexpr S& GetSecond() noexcept {
+        return this->template Get<1>();
+    }
+
+    constexpr const S& GetSecond() const noexcept {
+        return this->template Get<1>();
+    }
+};
+
+// Empty members cost nothing, even several of them and next to each other
+static_assert(std::is_empty_v<CompressedTuple<std::less<>, std::allocator<char>>>);
+static_assert(sizeof(CompressedTuple<void*, std::less<>>) == sizeof(void*));
+static_assert(sizeof(CompressedTuple<void*, std::less<>, std::allocator<char>>) == sizeof(void*));
+static_assert(sizeof(CompressedTuple<void*, size_t, std::allocator<char>>) == 2 * sizeof(void*));
+static_assert(sizeof(CompressedPair<void*, std::less<>>) == sizeof(void*));
+static_assert(std::is_trivially_copyable_v<CompressedTuple<void*, size_t, std::less<>>>);
+static_assert(CompressedTuple<int, long>(1, 2L).Get<1>() == 2);
@@ -0,0 +1,372 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class CycleCollectedRefCount;
+
+// Handed to `TraceRefs`, which passes it every `SharedPtr` member of the object:
+//     struct Node {
+//         void TraceRefs(CycleTracer& trace) const {
+//             trace(next);
+//             for (const auto& child : children) {
+//                 trace(child);
+//             }
+//         }
+//         SharedPtr<Node, CycleCollectedRefCount> next;
+//         std::vector<SharedPtr<Node, CycleCollectedRefCount>> children;
+//     };
+// Every owning pointer must be reported exactly once, and `TraceRefs` must do nothing else.
+class CycleTracer {
+    using Block = ControlBlockBase<CycleCollectedRefCount>;
+    using Visit = void (*)(Block*, void*);
+
+public:
+    template <typename U>
+    void operator()(const SharedPtr<U, CycleCollectedRefCount>& child) const {
+        if (child.block_) {
+            visit_(child.block_, context_);
+        }
+    }
+
+private:
+    CycleTracer(Visit visit, void* context) noexcept : visit_(visit), context_(context) {
+    }
+
+    Visit visit_;
+    void* context_;
+
+    friend class CycleCollectedRefCount;
+};
+
+// Types that report their outgoing references through `void TraceRefs(CycleTracer&) const`
+template <typename U, typename = void>
+struct IsCycleTraceable : std::false_type {};
+
+template <typename U>
+struct IsCycleTraceable<
+    U, std::void_t<decltype(std::declval<const U&>().TraceRefs(std::declval<CycleTracer&>()))>>
+    : std::true_type {};
+
+// Reference counting that also reclaims cycles, for object graphs that may point back at
+// themselves (parent links, observers, doubly linked lists) and never leave their thread:
+//     auto node = MakeShared<Node, CycleCollectedRefCount>();
+//     node->next = node;
+//     node.Reset();                          // leaked with any other policy
+//     CycleCollectedRefCount::Collect();     // destroyed here
+//
+// Counting is as cheap as `SingleThreadedRefCount`. A synchronous collector in the style of
+// Bacon and Rajan ("Concurrent Cycle Collection in Reference Counted Systems", 2001) finds
+// the rest: whenever the strong count of a traceable object drops to a non-zero value, its block
+// is put in the thread's candidate buffer (pinned by a weak reference). `Collect` then
+// subtracts the references the candidates' subgraphs hold on each other; whatever ends up with
+// no references from outside is garbage. Untraceable types are leaves: they can be part of
+// garbage, but never a candidate themselves.
+//
+// `Collect` runs when the buffer reaches `SetCollectThreshold` entries (inside the release that
+// filled it), on demand, and when the thread exits. Destructors of collected objects run in an
+// unspecified order, must not resurrect them and see their `WeakPtr`s to each other expired.
+// Blocks released on another thread, or after the thread's buffer is gone, are never collected.
+class CycleCollectedRefCount {
+    using Block = ControlBlockBase<CycleCollectedRefCount>;
+    using Trace = void (*)(const void*, CycleTracer&);
+
+    enum class Color : uint8_t {
+        kBlack,    // In use, or not looked at yet
+        kPurple,   // A candidate root: lost a reference and may be part of garbage now
+        kGray,     // Reached by trial deletion
+        kWhite,    // Not referenced from outside of the candidates' subgraphs
+        kGarbage,  // Being destroyed by the collector
+    };
+
+    // This thread's candidates; the thread collects once more when it exits
+    struct RootBuffer {
+        RootBuffer() {
+            current = this;
+        }
+
+        ~RootBuffer() {
+            while (!roots.empty()) {
+                Collect(*this);
+            }
+            current = nullptr;
+            exited = true;
+        }
+
+        std::vector<Block*> roots;
+        size_t threshold{kDefaultThreshold};
+        bool collecting{false};
+
+        inline static thread_local RootBuffer* current{nullptr};
+        inline static thread_local bool exited{false};
+    };
+
+public:
+    static constexpr size_t kDefaultThreshold = 10000;
+
+    template <typename U>
+    void OnCreate(PointeeTag<U>) noexcept {
+        if constexpr (IsCycleTraceable<U>::value) {
+            trace_ = [](const void* object, CycleTracer& tracer) {
+                static_cast<const U*>(object)->TraceRefs(tracer);
+            };
+        }
+    }
+
+    void AddRef() noexcept {
+        ++ref_counter_;
+    }
+
+    // An object being collected has no owners left, even if its block still counts some
+    bool TryAddRef() noexcept {
+        if (ref_counter_ == 0 || color_ == Color::kGarbage) {
+            return false;
+        }
+        ++ref_counter_;
+        return true;
+    }
+
+    bool ReleaseRef() noexcept {
+        if (--ref_counter_ == 0) {
+            color_ = Color::kBlack;
+            return true;
+        }
+        // Purple ones are in the buffer already
+        if (trace_ && color_ == Color::kBlack) {
+            Buffer();
+        }
+        return false;
+    }
+
+    void AddWeak() noexcept {
+        ++weak_counter_;
+    }
+
+    bool ReleaseWeak() noexcept {
+        return --weak_counter_ == 0;
+    }
+
+    size_t UseCount() const noexcept {
+        return ref_counter_;
+    }
+
+    // Reclaims every unreachable cycle among this thread's candidates; does nothing when called
+    // from a destructor the collector runs. Running out of memory for its work lists terminates.
+    static void Collect() noexcept {
+        if (RootBuffer* buffer = CurrentBuffer()) {
+            Collect(*buffer);
+        }
+    }
+
+    // Candidates waiting for the next collection on this thread
+    static size_t Candidates() noexcept {
+        RootBuffer* buffer = CurrentBuffer();
+        return buffer ? buffer->roots.size() : 0;
+    }
+
+    // Collect automatically once this thread has `threshold` candidates; 0 only collects on
+    // demand and at thread exit
+    static void SetCollectThreshold(size_t threshold) noexcept {
+        if (RootBuffer* buffer = CurrentBuffer()) {
+            buffer->threshold = threshold;
+        }
+    }
+
+private:
+    static RootBuffer* CurrentBuffer() noexcept {
+        if (!RootBuffer::current && !RootBuffer::exited) {
+            thread_local RootBuffer buffer;
+        }
+        return RootBuffer::current;
+    }
+
+    static CycleCollectedRefCount& Counts(Block* block) noexcept {
+        return *block;
+    }
+
+    // Makes this block a candidate root. It may be collected right away, so nothing touches
+    // `this` afterwards.
+    void Buffer() noexcept {
+        RootBuffer* buffer = CurrentBuffer();
+        if (!buffer) {
+            return;
+        }
+        try {
+            buffer->roots.push_back(static_cast<Block*>(this));
+        } catch (...) {
+            // Without a slot this is just a missed candidate
+            return;
+        }
+        color_ = Color::kPurple;
+        AddWeak();
+        if (buffer->threshold && buffer->roots.size() >= buffer->threshold &&
+            !buffer->collecting) {
+            Collect(*buffer);
+        }
+    }
+
+    // The blocks `block`'s object points to, appended to `out`
+    static void Children(Block* block, std::vector<Block*>& out) {
+        CycleCollectedRefCount& counts = Counts(block);
+        if (!counts.trace_) {
+            return;
+        }
+        CycleTracer tracer(
+            [](Block* child, void* context) {
+                static_cast<std::vector<Block*>*>(context)->push_back(child);
+            },
+            &out);
+        counts.trace_(block->GetObject(), tracer);
+    }
+
+    static void Collect(RootBuffer& buffer) noexcept {
+        if (buffer.collecting) {
+            return;
+        }
+        buffer.collecting = true;
+        std::vector<Block*> roots;
+        roots.swap(buffer.roots);
+        CollectCycles(roots);
+        for (Block* root : roots) {
+            root->DecWeak();
+        }
+        buffer.collecting = false;
+    }
+
+    static void CollectCycles(std::vector<Block*>& roots) {
+        // Trial deletion: take away the references from inside each candidate's subgraph
+        std::vector<Block*> candidates;
+        std::vector<Block*> stack;
+        for (Block* root : roots) {
+            if (Counts(root).color_ == Color::kPurple) {
+                MarkGray(root, stack);
+                candidates.push_back(root);
+            }
+        }
+        // Whatever still has references is alive, and so is everything it points to
+        for (Block* root : candidates) {
+            Scan(root, stack);
+        }
+        std::vector<Block*> garbage;
+        for (Block* root : candidates) {
+            CollectWhite(root, stack, garbage);
+        }
+        FreeGarbage(garbage, stack);
+    }
+
+    static void MarkGray(Block* root, std::vector<Block*>& stack) {
+        if (Counts(root).color_ == Color::kGray) {
+            return;
+        }
+        Counts(root).color_ = Color::kGray;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            Block* block = stack.back();
+            stack.pop_back();
+            size_t first = stack.size();
+            Children(block, stack);
+            for (size_t i = first; i < stack.size();) {
+                CycleCollectedRefCount& child = Counts(stack[i]);
+                --child.ref_counter_;
+                if (child.color_ == Color::kGray) {
+                    stack[i] = stack.back();
+                    stack.pop_back();
+                } else {
+                    child.color_ = Color::kGray;
+                    ++i;
+                }
+            }
+        }
+    }
+
+    static void Scan(Block* root, std::vector<Block*>& stack) {
+        stack.push_back(root);
+        while (!stack.empty()) {
+            Block* block = stack.back();
+            stack.pop_back();
+            CycleCollectedRefCount& counts = Counts(block);
+            if (counts.color_ != Color::kGray) {
+                continue;
+            }
+            if (counts.ref_counter_ > 0) {
+                ScanBlack(block);
+            } else {
+                counts.color_ = Color::kWhite;
+                Children(block, stack);
+            }
+        }
+    }
+
+    // Undoes the trial deletion below `root`
+    static void ScanBlack(Block* root) {
+        std::vector<Block*> stack;
+        Counts(root).color_ = Color::kBlack;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            Block* block = stack.back();
+            stack.pop_back();
+            size_t first = stack.size();
+            Children(block, stack);
+            for (size_t i = first; i < stack.size();) {
+                CycleCollectedRefCount& child = Counts(stack[i]);
+                ++child.ref_counter_;
+                if (child.color_ == Color::kBlack) {
+                    stack[i] = stack.back();
+                    stack.pop_back();
+                } else {
+                    child.color_ = Color::kBlack;
+                    ++i;
+                }
+            }
+        }
+    }
+
+    static void CollectWhite(Block* root, std::vector<Block*>& stack,
+                             std::vector<Block*>& garbage) {
+        stack.push_back(root);
+        while (!stack.empty()) {
+            Block* block = stack.back();
+            stack.pop_back();
+            CycleCollectedRefCount& counts = Counts(block);
+            if (counts.color_ != Color::kWhite) {
+                continue;
+            }
+            counts.color_ = Color::kGarbage;
+            garbage.push_back(block);
+            Children(block, stack);
+        }
+    }
+
+    static void FreeGarbage(std::vector<Block*>& garbage, std::vector<Block*>& stack) {
+        // Put the trial-deleted references back, plus one of our own, so that the destructors
+        // releasing each other never take a count to zero
+        for (Block* block : garbage) {
+            Children(block, stack);
+            ++Counts(block).ref_counter_;
+            block->IncWeak();
+        }
+        for (Block* child : stack) {
+            ++Counts(child).ref_counter_;
+        }
+        stack.clear();
+        for (Block* block : garbage) {
+            block->DestroyObject();
+        }
+        for (Block* block : garbage) {
+            CycleCollectedRefCount& counts = Counts(block);
+            counts.ref_counter_ = 0;
+            counts.color_ = Color::kBlack;
+            block->DecWeak();
+        }
+    }
+
+    uint32_t ref_counter_{1};
+    uint32_t weak_counter_{1};
+    Trace trace_{nullptr};
+    Color color_{Color::kBlack};
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <typeinfo>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+// Per-type control block statistics. Only collected when the whole program is built with
+// `SMART_PTRS_INSTRUMENTATION` defined; otherwise the hooks in sw_fwd.h compile to nothing and
+// `Dump` prints an empty table.
+//
+// A "zombie" is a block whose object is already destroyed but which is kept allocated by weak
+// references. Objects still live at exit usually mean a reference cycle.
+struct TypeStats {
+    explicit TypeStats(std::string type_name) : name(std::move(type_name)) {
+    }
+
+    // A new block starts with one strong and one weak reference
+    void OnCreate() noexcept {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        increments.fetch_add(2, std::memory_order_relaxed);
+        size_t now = live.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = peak_live.load(std::memory_order_relaxed);
+        while (peak < now &&
+               !peak_live.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    void OnDestroyObject() noexcept {
+        live.fetch_sub(1, std::memory_order_relaxed);
+        zombies.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void OnDeallocate() noexcept {
+        zombies.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Statistics of all blocks managing a `U`; never destroyed, so usable from `atexit`
+    template <typename U>
+    static TypeStats& For() {
+        static TypeStats* stats = Register(new TypeStats(Demangle(typeid(U).name())));
+        return *stats;
+    }
+
+    // One line per type that ever had a control block
+    static void Dump(std::ostream& out) {
+        out << std::left << std::setw(40) << "type" << std::right << std::setw(10) << "live"
+            << std::setw(10) << "peak" << std::setw(12) << "allocs" << std::setw(12) << "incs"
+            << std::setw(12) << "decs" << std::setw(10) << "zombies" << '\n';
+        for (auto stats = head.load(std::memory_order_acquire); stats; stats = stats->next) {
+            out << std::left << std::setw(40) << stats->name << std::right << std::setw(10)
+                << stats->live.load(std::memory_order_relaxed) << std::setw(10)
+                << stats->peak_live.load(std::memory_order_relaxed) << std::setw(12)
+                << stats->allocations.load(std::memory_order_relaxed) << std::setw(12)
+                << stats->increments.load(std::memory_order_relaxed) << std::setw(12)
+                << stats->decrements.load(std::memory_order_relaxed) << std::setw(10)
+                << stats->zombies.load(std::memory_order_relaxed) << '\n';
+        }
+    }
+
+    // Dumps to stderr when the program exits; calling it more than once has no further effect
+    static void ReportAtExit() {
+        static bool registered = (std::atexit([] { Dump(std::cerr); }), true);
+        (void)registered;
+    }
+
+    std::string name;
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> peak_live{0};
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> increments{0};
+    std::atomic<size_t> decrements{0};
+    std::atomic<size_t> zombies{0};
+    TypeStats* next{nullptr};
+
+private:
+    static TypeStats* Register(TypeStats* stats) {
+        stats->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(stats->next, stats, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+        return stats;
+    }
+
+    static std::string Demangle(const char* name) {
+#if __has_include(<cxxabi.h>)
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if (status == 0 && demangled) {
+            std::string result(demangled);
+            std::free(demangled);
+            return result;
+        }
+#endif
+        return name;
+    }
+
+    inline static std::atomic<TypeStats*> head{nullptr};
+};
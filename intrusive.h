@@ -0,0 +1,181 @@
+#pragma once
+
+#include "ref_count.h"
+
+#include <atomic>
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Base for objects that carry their own reference counter, so that `IntrusivePtr<T>` is a single
+// pointer and needs no control block:
+//     class Node : public IntrusiveRefCounted<Node> { ... };
+//     IntrusivePtr<Node> node = MakeIntrusive<Node>(args...);
+// `Policy` only picks whether the counter is atomic: `SingleThreadedRefCount` gives a plain
+// counter, anything else an atomic one. There are no weak references.
+template <typename T, typename Policy = DefaultRefCount>
+class IntrusiveRefCounted {
+public:
+    size_t UseCount() const noexcept {
+        if constexpr (kAtomic) {
+            return ref_counter_.load(std::memory_order_relaxed);
+        } else {
+            return ref_counter_;
+        }
+    }
+
+protected:
+    IntrusiveRefCounted() noexcept {
+    }
+
+    // A copy of the object is a new object with no owners yet
+    IntrusiveRefCounted(const IntrusiveRefCounted&) noexcept {
+    }
+
+    IntrusiveRefCounted& operator=(const IntrusiveRefCounted&) noexcept {
+        return *this;
+    }
+
+    ~IntrusiveRefCounted() = default;
+
+private:
+    static constexpr bool kAtomic = !std::is_same_v<Policy, SingleThreadedRefCount>;
+
+    void AddRef() const noexcept {
+        if constexpr (kAtomic) {
+            ref_counter_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ++ref_counter_;
+        }
+    }
+
+    // Returns true if the last reference is gone
+    bool ReleaseRef() const noexcept {
+        if constexpr (kAtomic) {
+            return ref_counter_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        } else {
+            return --ref_counter_ == 0;
+        }
+    }
+
+    mutable std::conditional_t<kAtomic, std::atomic<uint32_t>, uint32_t> ref_counter_{0};
+
+    template <typename U>
+    friend class IntrusivePtr;
+};
+
+// Same interface as `SharedPtr` where it makes sense; a raw pointer to a counted object can be
+// turned into an owner at any time, e.g. from `this`
+template <typename T>
+class IntrusivePtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    IntrusivePtr() {
+    }
+
+    IntrusivePtr(std::nullptr_t) {
+    }
+
+    explicit IntrusivePtr(T* ptr) : ptr_(ptr) {
+        if (ptr_) {
+            ptr_->AddRef();
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.ptr_) {
+    }
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    template <typename U>
+    IntrusivePtr(const IntrusivePtr<U>& other) : IntrusivePtr(other.ptr_) {
+    }
+    template <typename U>
+    IntrusivePtr(IntrusivePtr<U>&& other) noexcept : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    IntrusivePtr& operator=(const IntrusivePtr& other) {
+        IntrusivePtr(other).Swap(*this);
+        return *this;
+    }
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+        IntrusivePtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~IntrusivePtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() noexcept {
+        if (ptr_ && ptr_->ReleaseRef()) {
+            delete ptr_;
+        }
+        ptr_ = nullptr;
+    }
+
+    void Reset(T* ptr) {
+        IntrusivePtr(ptr).Swap(*this);
+    }
+
+    void Swap(IntrusivePtr& other) noexcept {
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator*() const {
+        return *ptr_;
+    }
+    T* operator->() const {
+        return ptr_;
+    }
+    size_t UseCount() const {
+        if (!ptr_) {
+            return 0;
+        }
+        return ptr_->UseCount();
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+private:
+    T* ptr_{nullptr};
+
+    template <typename U>
+    friend class IntrusivePtr;
+};
+
+template <typename T, typename U>
+inline bool operator==(const IntrusivePtr<T>& left, const IntrusivePtr<U>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const IntrusivePtr<T>& left, const IntrusivePtr<U>& right) {
+    return !(left == right);
+}
+
+template <typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusive(Args&&... args) {
+    return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
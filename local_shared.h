@@ -0,0 +1,228 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Shared ownership confined to one thread. All `LocalSharedPtr`s copied from one another share a
+// plain (non-atomic) count, and the group as a whole holds a single reference on the
+// `ControlBlockBase`, so copies and releases inside the thread never need an atomic RMW:
+//     auto session = MakeLocalShared<Session>(args...);
+//     auto copy = session;                        // plain increment
+//     pool.Post([sp = session.ToShared()] {...});  // one atomic increment when it escapes
+//     LocalSharedPtr<Session> back(std::move(sp));  // and back again on another thread
+// A `LocalSharedPtr` and its copies must only be used by one thread at a time; convert to
+// `SharedPtr` (`ToShared`) before handing the object to another thread.
+template <typename Policy>
+struct LocalSharedNode {
+    // Drops one local owner; the last one releases the reference on the block
+    void Release() noexcept {
+        if (--count != 0) {
+            return;
+        }
+        // An embedded node is destroyed together with the object by `DecRef`
+        ControlBlockBase<Policy>* owned = block;
+        if (!embedded) {
+            delete this;
+        }
+        owned->DecRef();
+    }
+
+    uint32_t count{1};
+    bool embedded{false};  // Part of the object's allocation, see `MakeLocalShared`
+    ControlBlockBase<Policy>* block{nullptr};
+};
+
+// What `MakeLocalShared` allocates: the node and the object share one control block
+template <typename U, typename Policy>
+struct LocalSharedBox {
+    template <typename... Args>
+    LocalSharedBox(Args&&... args) : value(std::forward<Args>(args)...) {
+    }
+
+    LocalSharedNode<Policy> node;
+    U value;
+};
+
+template <typename T, typename Policy>
+class LocalSharedPtr {
+    using Node = LocalSharedNode<Policy>;
+
+public:
+    using ElementType = std::remove_extent_t<T>;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    LocalSharedPtr() {
+    }
+
+    LocalSharedPtr(std::nullptr_t) {
+    }
+
+    LocalSharedPtr(const LocalSharedPtr& other) : ptr_(other.ptr_), node_(other.node_) {
+        if (node_) {
+            ++node_->count;
+        }
+    }
+    LocalSharedPtr(LocalSharedPtr&& other) noexcept : ptr_(other.ptr_), node_(other.node_) {
+        other.ptr_ = nullptr;
+        other.node_ = nullptr;
+    }
+
+    template <typename U>
+    LocalSharedPtr(const LocalSharedPtr<U, Policy>& other) : ptr_(other.ptr_), node_(other.node_) {
+        if (node_) {
+            ++node_->count;
+        }
+    }
+    template <typename U>
+    LocalSharedPtr(LocalSharedPtr<U, Policy>&& other) noexcept
+        : ptr_(other.ptr_), node_(other.node_) {
+        other.ptr_ = nullptr;
+        other.node_ = nullptr;
+    }
+
+    // Bring a shared object into this thread; takes one reference on the control block for the
+    // whole group of local copies. The rvalue overload reuses `other`'s reference instead.
+    template <typename U>
+    explicit LocalSharedPtr(const SharedPtr<U, Policy>& other) {
+        if (other.block_) {
+            node_ = new Node{1, false, other.block_};
+            ptr_ = other.ptr_;
+            other.block_->IncRef();
+        }
+    }
+    template <typename U>
+    explicit LocalSharedPtr(SharedPtr<U, Policy>&& other) {
+        if (other.block_) {
+            node_ = new Node{1, false, other.block_};
+            ptr_ = other.ptr_;
+            other.ptr_ = nullptr;
+            other.block_ = nullptr;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    LocalSharedPtr& operator=(const LocalSharedPtr& other) {
+        LocalSharedPtr(other).Swap(*this);
+        return *this;
+    }
+    LocalSharedPtr& operator=(LocalSharedPtr&& other) noexcept {
+        LocalSharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    template <typename U>
+    LocalSharedPtr& operator=(const LocalSharedPtr<U, Policy>& other) {
+        LocalSharedPtr(other).Swap(*this);
+        return *this;
+    }
+    template <typename U>
+    LocalSharedPtr& operator=(LocalSharedPtr<U, Policy>&& other) noexcept {
+        LocalSharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~LocalSharedPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() noexcept {
+        if (node_) {
+            node_->Release();
+        }
+        ptr_ = nullptr;
+        node_ = nullptr;
+    }
+
+    void Swap(LocalSharedPtr& other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        std::swap(node_, other.node_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    ElementType* Get() const {
+        return ptr_;
+    }
+    ElementType& operator*() const {
+        return *ptr_;
+    }
+    ElementType* operator->() const {
+        return ptr_;
+    }
+    // Local owners only; every `SharedPtr` made by `ToShared` is counted in the block instead
+    size_t UseCount() const {
+        if (!node_) {
+            return 0;
+        }
+        return node_->count;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    // A thread-safe owner of the same object, e.g. to hand it to another thread
+    SharedPtr<T, Policy> ToShared() const {
+        if (!node_) {
+            return SharedPtr<T, Policy>();
+        }
+        return SharedPtr<T, Policy>(ptr_, node_->block);
+    }
+
+private:
+    ElementType* ptr_{nullptr};
+    Node* node_{nullptr};
+
+    template <typename U, typename P>
+    friend class LocalSharedPtr;
+
+    template <typename U, typename P, typename... Args>
+    friend LocalSharedPtr<U, P> MakeLocalShared(Args&&... args);
+};
+
+template <typename T, typename U, typename Policy>
+inline bool operator==(const LocalSharedPtr<T, Policy>& left,
+                       const LocalSharedPtr<U, Policy>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename U, typename Policy>
+inline bool operator!=(const LocalSharedPtr<T, Policy>& left,
+                       const LocalSharedPtr<U, Policy>& right) {
+    return !(left == right);
+}
+
+// One allocation holds the control block, the local node and the object
+template <typename U, typename Policy = DefaultRefCount, typename... Args>
+LocalSharedPtr<U, Policy> MakeLocalShared(Args&&... args) {
+    static_assert(!std::is_array_v<U>, "MakeLocalShared does not support arrays");
+    using Box = LocalSharedBox<U, Policy>;
+    auto block = new ControlBlockHolder<Box, Policy>(std::forward<Args>(args)...);
+    Box* box = block->GetRawPointer();
+    box->node.embedded = true;
+    // The block's initial reference belongs to the node
+    SharedPtr<U, Policy> owner;
+    owner.AdoptBlock(&box->value, block);
+    box->node.block = owner.block_;
+    owner.ptr_ = nullptr;
+    owner.block_ = nullptr;
+
+    LocalSharedPtr<U, Policy> local;
+    local.ptr_ = &box->value;
+    local.node_ = &box->node;
+    return local;
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "pool_allocator.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Default reset hook of `ObjectPool`: objects come back exactly as they were left
+struct NoReset {
+    template <typename U>
+    void operator()(U&) const noexcept {
+    }
+};
+
+template <typename T, typename Reset = NoReset>
+class ObjectPool;
+
+// Hands the object back to its pool instead of deleting it; a default-constructed one (what an
+// empty handle holds) deletes
+template <typename T, typename Reset = NoReset>
+class PoolReturnDeleter {
+public:
+    PoolReturnDeleter() noexcept {
+    }
+
+    explicit PoolReturnDeleter(ObjectPool<T, Reset>* pool) noexcept : pool_(pool) {
+    }
+
+    void operator()(T* ptr) const noexcept {
+        if (pool_) {
+            pool_->Return(ptr);
+        } else {
+            delete ptr;
+        }
+    }
+
+private:
+    ObjectPool<T, Reset>* pool_{nullptr};
+};
+
+// Recycles whole objects, e.g. parser messages that keep their buffers between uses:
+//     ObjectPool<Message, ClearMessage> pool;
+//     auto message = pool.Acquire();        // UniquePtr<Message, PoolReturnDeleter<...>>
+//     auto shared = pool.AcquireShared();   // SharedPtr<Message>
+// Dropping the handle runs `reset(object)` and puts the object on the releasing thread's free
+// list; `Acquire` takes from the current thread's list first, so in steady state neither
+// touches `operator new` or an atomic. A thread keeps at most `local_capacity` objects and
+// moves half of them to a list shared by all threads (at most `shared_capacity`, the rest is
+// deleted) when it has too many, and takes some back from there when it runs out. New objects
+// are value-initialized.
+//
+// The pool must outlive its handles. Objects cached by other threads when the pool is destroyed
+// are only deleted when those threads exit, so pools are meant to be long-lived; a static pool
+// is fine, handles released during static destruction go to the shared list.
+template <typename T, typename Reset>
+class ObjectPool {
+    // This thread's free lists of every pool of this type. Once they are destroyed at thread
+    // exit (before the statics, for the main thread) the thread only uses the shared lists.
+    struct LocalCaches {
+        struct Cache {
+            uint64_t pool;
+            std::vector<T*> free;
+        };
+
+        ~LocalCaches() {
+            for (Cache& cache : caches) {
+                for (T* ptr : cache.free) {
+                    delete ptr;
+                }
+            }
+            exited = true;
+        }
+
+        std::vector<Cache> caches;
+        size_t last{0};
+
+        inline static thread_local bool exited{false};
+    };
+
+public:
+    using Handle = UniquePtr<T, PoolReturnDeleter<T, Reset>>;
+
+    explicit ObjectPool(size_t local_capacity = 256, size_t shared_capacity = 4096,
+                        Reset reset = Reset())
+        : local_capacity_(local_capacity),
+          shared_capacity_(shared_capacity),
+          reset_(std::move(reset)),
+          id_(next_id.fetch_add(1, std::memory_order_relaxed)) {
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        for (T* ptr : shared_) {
+            delete ptr;
+        }
+        LocalCaches* local = Local();
+        if (!local) {
+            return;
+        }
+        for (size_t i = 0; i < local->caches.size(); ++i) {
+            if (local->caches[i].pool == id_) {
+                for (T* ptr : local->caches[i].free) {
+                    delete ptr;
+                }
+                local->caches.erase(local->caches.begin() + i);
+                local->last = 0;
+                break;
+            }
+        }
+    }
+
+    Handle Acquire() {
+        return Handle(Take(), PoolReturnDeleter<T, Reset>(this));
+    }
+
+    // The control block comes from `PoolAllocator`, so this does not allocate either
+    SharedPtr<T> AcquireShared() {
+        return SharedPtr<T>(Take(), PoolReturnDeleter<T, Reset>(this), PoolAllocator<char>());
+    }
+
+    // Objects waiting in the shared list, not counting the threads' own lists
+    size_t SharedSize() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return shared_.size();
+    }
+
+private:
+    T* Take() {
+        std::vector<T*>* local_free = LocalFree();
+        if (!local_free) {
+            return TakeShared();
+        }
+        std::vector<T*>& free = *local_free;
+        if (free.empty()) {
+            std::lock_guard<std::mutex> guard(mutex_);
+            size_t batch = local_capacity_ / 2 < shared_.size() ? local_capacity_ / 2
+                                                                : shared_.size();
+            free.insert(free.end(), shared_.end() - batch, shared_.end());
+            shared_.resize(shared_.size() - batch);
+        }
+        if (free.empty()) {
+            return new T();
+        }
+        T* ptr = free.back();
+        free.pop_back();
+        return ptr;
+    }
+
+    void Return(T* ptr) noexcept {
+        try {
+            reset_(*ptr);
+            std::vector<T*>* free = LocalFree();
+            if (!free) {
+                if (ReturnShared(ptr)) {
+                    return;
+                }
+            } else {
+                if (free->size() >= local_capacity_) {
+                    Spill(*free);
+                }
+                if (free->size() < local_capacity_) {
+                    free->push_back(ptr);
+                    return;
+                }
+            }
+        } catch (...) {
+        }
+        delete ptr;
+    }
+
+    // For threads whose local lists are gone
+    T* TakeShared() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (!shared_.empty()) {
+                T* ptr = shared_.back();
+                shared_.pop_back();
+                return ptr;
+            }
+        }
+        return new T();
+    }
+
+    bool ReturnShared(T* ptr) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (shared_.size() >= shared_capacity_) {
+            return false;
+        }
+        shared_.push_back(ptr);
+        return true;
+    }
+
+    // Moves the older half of a full local list to the shared one
+    void Spill(std::vector<T*>& free) {
+        size_t half = free.size() / 2;
+        std::lock_guard<std::mutex> guard(mutex_);
+        size_t kept = 0;
+        for (size_t i = 0; i < half; ++i) {
+            if (shared_.size() < shared_capacity_) {
+                shared_.push_back(free[i]);
+            } else {
+                delete free[i];
+            }
+        }
+        for (size_t i = half; i < free.size(); ++i) {
+            free[kept++] = free[i];
+        }
+        free.resize(kept);
+    }
+
+    // Null once this thread's lists are destroyed
+    static LocalCaches* Local() {
+        if (LocalCaches::exited) {
+            return nullptr;
+        }
+        thread_local LocalCaches local;
+        return &local;
+    }
+
+    std::vector<T*>* LocalFree() {
+        LocalCaches* local = Local();
+        if (!local) {
+            return nullptr;
+        }
+        if (local->last < local->caches.size() && local->caches[local->last].pool == id_) {
+            return &local->caches[local->last].free;
+        }
+        for (size_t i = 0; i < local->caches.size(); ++i) {
+            if (local->caches[i].pool == id_) {
+                local->last = i;
+                return &local->caches[i].free;
+            }
+        }
+        local->caches.push_back({id_, {}});
+        local->last = local->caches.size() - 1;
+        return &local->caches.back().free;
+    }
+
+    const size_t local_capacity_;
+    const size_t shared_capacity_;
+    Reset reset_;
+    // Never reused, so a thread's list of a destroyed pool is never picked up by a new one
+    const uint64_t id_;
+    mutable std::mutex mutex_;
+    std::vector<T*> shared_;
+
+    inline static std::atomic<uint64_t> next_id{1};
+
+    friend class PoolReturnDeleter<T, Reset>;
+};
+
+static_assert(sizeof(PoolReturnDeleter<int>) == sizeof(void*));
+static_assert(sizeof(ObjectPool<int>::Handle) == 2 * sizeof(void*));
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+// Fixed-size freelist allocator for control blocks, meant for `AllocateShared`:
+//     auto sp = AllocateShared<Node>(PoolAllocator<Node>(), args...);
+//
+// Every block size gets its own pool. A thread keeps freed blocks in a thread-local list of at
+// most `kBatchSize` blocks plus one full spare batch; once both are full, the spare goes to a
+// global list of batches, where any thread that runs out takes its next batch from (before
+// carving a new arena). So blocks freed on a consumer thread flow back to the producer in
+// batches, one lock per `kBatchSize` blocks, and in steady state allocation and deallocation
+// never reach `operator new`. Arenas are never returned to the system.
+//
+// Blocks freed on a thread after its lists are gone (e.g. a static `SharedPtr` released during
+// exit) go straight to the global list.
+
+template <size_t Size, size_t Align>
+class FixedSizePool {
+    // The first node of a batch also knows the next batch and its own length
+    struct FreeNode {
+        FreeNode* next;
+        FreeNode* next_batch;
+        size_t count;
+    };
+
+    static constexpr size_t kAlign = Align < alignof(FreeNode) ? alignof(FreeNode) : Align;
+    static constexpr size_t kBlockSize =
+        ((Size < sizeof(FreeNode) ? sizeof(FreeNode) : Size) + kAlign - 1) & ~(kAlign - 1);
+    static constexpr size_t kArenaSize = 64 * 1024;
+    static constexpr size_t kBlocksPerArena =
+        kArenaSize / kBlockSize > 0 ? kArenaSize / kBlockSize : 1;
+    static constexpr size_t kBatchSize = 128;
+
+    struct Batch {
+        FreeNode* head{nullptr};
+        size_t count{0};
+    };
+
+    // Hands its blocks over to the global list when the thread exits
+    struct LocalList {
+        ~LocalList() {
+            exited = true;
+            PushGlobal(active);
+            PushGlobal(spare);
+        }
+
+        Batch active;
+        Batch spare;
+
+        inline static thread_local bool exited{false};
+    };
+
+public:
+    static void* Allocate() {
+        if (LocalList::exited) {
+            Batch batch = PopGlobal(1);
+            if (!batch.head) {
+                batch = Carve();
+                PushGlobal({batch.head->next, batch.count - 1});
+            }
+            return batch.head;
+        }
+        LocalList& local = local_list;
+        if (!local.active.head) {
+            if (local.spare.head) {
+                local.active = local.spare;
+                local.spare = Batch();
+            } else {
+                local.active = Refill();
+            }
+        }
+        FreeNode* node = local.active.head;
+        local.active.head = node->next;
+        --local.active.count;
+        return node;
+    }
+
+    static void Deallocate(void* ptr) noexcept {
+        auto node = static_cast<FreeNode*>(ptr);
+        node->next = nullptr;
+        if (LocalList::exited) {
+            PushGlobal({node, 1});
+            return;
+        }
+        LocalList& local = local_list;
+        if (local.active.count >= kBatchSize) {
+            PushGlobal(local.spare);
+            local.spare = local.active;
+            local.active = Batch();
+        }
+        node->next = local.active.head;
+        local.active.head = node;
+        ++local.active.count;
+    }
+
+private:
+    static Batch Refill() {
+        Batch batch = PopGlobal(kBatchSize);
+        return batch.head ? batch : Carve();
+    }
+
+    static void PushGlobal(Batch batch) noexcept {
+        if (!batch.head) {
+            return;
+        }
+        batch.head->count = batch.count;
+        std::lock_guard<std::mutex> guard(global_mutex);
+        batch.head->next_batch = global_head;
+        global_head = batch.head;
+    }
+
+    // The first global batch, or its first `limit` blocks
+    static Batch PopGlobal(size_t limit) {
+        std::lock_guard<std::mutex> guard(global_mutex);
+        FreeNode* head = global_head;
+        if (!head) {
+            return Batch();
+        }
+        if (head->count <= limit) {
+            global_head = head->next_batch;
+            return {head, head->count};
+        }
+        FreeNode* tail = head;
+        for (size_t i = 1; i < limit; ++i) {
+            tail = tail->next;
+        }
+        FreeNode* rest = tail->next;
+        rest->count = head->count - limit;
+        rest->next_batch = head->next_batch;
+        global_head = rest;
+        tail->next = nullptr;
+        return {head, limit};
+    }
+
+    // A new arena: one batch for the caller, the rest for the global list
+    static Batch Carve() {
+        auto arena = static_cast<char*>(
+            ::operator new(kBlocksPerArena * kBlockSize, std::align_val_t(kAlign)));
+        Batch batch;
+        for (size_t i = kBlocksPerArena; i > 0; --i) {
+            auto node = reinterpret_cast<FreeNode*>(arena + (i - 1) * kBlockSize);
+            if (batch.count == kBatchSize) {
+                PushGlobal(batch);
+                batch = Batch();
+            }
+            node->next = batch.head;
+            batch.head = node;
+            ++batch.count;
+        }
+        return batch;
+    }
+
+    inline static thread_local LocalList local_list;
+    inline static std::mutex global_mutex;
+    inline static FreeNode* global_head{nullptr};
+};
+
+// Stateless standard allocator on top of `FixedSizePool`; single objects come from the pool,
+// arrays go straight to `operator new`
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U>;
+    };
+
+    PoolAllocator() noexcept {
+    }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {
+    }
+
+    T* allocate(size_t n) {
+        if (n == 1) {
+            return static_cast<T*>(FixedSizePool<sizeof(T), alignof(T)>::Allocate());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        if (n == 1) {
+            FixedSizePool<sizeof(T), alignof(T)>::Deallocate(ptr);
+            return;
+        }
+        ::operator delete(ptr, std::align_val_t(alignof(T)));
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return false;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+// Reference counting policies for the control blocks.
+//
+// A policy owns both counters. The weak counter holds one extra reference on behalf of all
+// strong owners, so the object is destroyed when `ReleaseRef` returns true and the block itself
+// is freed when `ReleaseWeak` returns true. A freshly created block is owned by exactly one
+// `SharedPtr`. Counters are 32-bit, so both of them take a single word of the block.
+
+// Counters that different cores write all the time are kept this far apart, so that they never
+// share a cache line
+inline constexpr size_t kCacheLineSize = 64;
+
+// Plain counters for objects that never leave their thread: no synchronization at all
+class SingleThreadedRefCount {
+public:
+    void AddRef() noexcept {
+        ++ref_counter_;
+    }
+
+    // Used by `WeakPtr::Lock` and the promoting `SharedPtr` constructor
+    bool TryAddRef() noexcept {
+        if (ref_counter_ == 0) {
+            return false;
+        }
+        ++ref_counter_;
+        return true;
+    }
+
+    // Returns true if the last strong reference is gone
+    bool ReleaseRef() noexcept {
+        return --ref_counter_ == 0;
+    }
+
+    void AddWeak() noexcept {
+        ++weak_counter_;
+    }
+
+    // Returns true if the control block itself can be freed
+    bool ReleaseWeak() noexcept {
+        return --weak_counter_ == 0;
+    }
+
+    size_t UseCount() const noexcept {
+        return ref_counter_;
+    }
+
+protected:
+    uint32_t ref_counter_{1};
+    uint32_t weak_counter_{1};
+};
+
+// Thread-safe counters: relaxed increments, acquire/release decrements (so the destructor sees
+// every write made through other owners)
+class AtomicRefCount {
+public:
+    void AddRef() noexcept {
+        ref_counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Lock-free "increment if non-zero": never resurrects an expired object
+    bool TryAddRef() noexcept {
+        uint32_t count = ref_counter_.load(std::memory_order_relaxed);
+        while (count != 0) {
+            if (ref_counter_.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReleaseRef() noexcept {
+        return ref_counter_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    void AddWeak() noexcept {
+        weak_counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool ReleaseWeak() noexcept {
+        return weak_counter_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    size_t UseCount() const noexcept {
+        return ref_counter_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    std::atomic<uint32_t> ref_counter_{1};
+    std::atomic<uint32_t> weak_counter_{1};
+};
+
+// Thread-safe counters packed into one 64-bit word, strong count in the low half. Both counts are
+// read with a single load, so a sole owner without weak references (the common case for
+// short-lived objects) destroys the object and frees the block without any atomic RMW, and
+// `TryAddRef` decides on both counts in one CAS. Overflowing either half aborts the program.
+class PackedRefCount {
+public:
+    void AddRef() noexcept {
+        CheckOverflow(word_.fetch_add(kOneRef, std::memory_order_relaxed) & kRefMask, kRefMask);
+    }
+
+    bool TryAddRef() noexcept {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        while (word & kRefMask) {
+            CheckOverflow(word & kRefMask, kRefMask);
+            if (word_.compare_exchange_weak(word, word + kOneRef, std::memory_order_acq_rel,
+                                            std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReleaseRef() noexcept {
+        // The only owner and nobody to promote a weak reference: no one else can reach the word
+        if (word_.load(std::memory_order_acquire) == kOneRef + kOneWeak) {
+            word_.store(kOneWeak, std::memory_order_relaxed);
+            return true;
+        }
+        return (word_.fetch_sub(kOneRef, std::memory_order_acq_rel) & kRefMask) == 1;
+    }
+
+    void AddWeak() noexcept {
+        CheckOverflow(word_.fetch_add(kOneWeak, std::memory_order_relaxed) & ~kRefMask,
+                      ~kRefMask);
+    }
+
+    bool ReleaseWeak() noexcept {
+        if (word_.load(std::memory_order_acquire) == kOneWeak) {
+            return true;
+        }
+        return (word_.fetch_sub(kOneWeak, std::memory_order_acq_rel) & ~kRefMask) == kOneWeak;
+    }
+
+    size_t UseCount() const noexcept {
+        return word_.load(std::memory_order_relaxed) & kRefMask;
+    }
+
+protected:
+    static constexpr uint64_t kOneRef = 1;
+    static constexpr uint64_t kOneWeak = uint64_t{1} << 32;
+    static constexpr uint64_t kRefMask = kOneWeak - 1;
+
+    // `old` is the masked half before the increment
+    static void CheckOverflow(uint64_t old, uint64_t mask) noexcept {
+        if (old == mask) {
+            std::abort();
+        }
+    }
+
+    std::atomic<uint64_t> word_{kOneRef + kOneWeak};
+};
+
+// Opt-in for heavily contended objects: the counters of `Policy` (`AtomicRefCount` or
+// `PackedRefCount`) get a cache line of their own, so the object stored right after them in
+// `ControlBlockHolder` never shares it,
+//     auto sp = MakeShared<Hot, CacheAlignedRefCount<AtomicRefCount>>(args...);
+// The block grows by up to two cache lines and is allocated with cache-line alignment.
+template <typename Policy>
+class alignas(kCacheLineSize) CacheAlignedRefCount : public Policy {
+    // Explicit, so that derived classes cannot reuse it as tail padding
+    char padding_[kCacheLineSize - sizeof(Policy)];
+};
+
+static_assert(sizeof(PackedRefCount) == 8);
+static_assert(sizeof(CacheAlignedRefCount<AtomicRefCount>) == kCacheLineSize);
+
+// `SharedPtr<T>` may be handed to another thread unless told otherwise
+using DefaultRefCount = AtomicRefCount;
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "ref_count.h"
+
+#include <atomic>
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <utility>
+
+// Reference counting for a few read-mostly objects that every thread copies all the time
+// (configuration, schemas):
+//     auto schema = MakeShardedShared<Schema>(args...);  // the owner
+//     ShardedSharedPtr<Schema> copy = schema;            // counted in the thread's own shard
+//
+// The strong count is split over `kShards` cache-line-sized counters and each thread counts in
+// its own slot, so copies made on different cores never touch the same cache line. A shard may
+// go negative when a copy dies on another thread than it was made on; only the sum matters.
+//
+// The pointer returned by `MakeShardedShared` is the owner (moving it moves the ownership, its
+// copies are plain references). While it lives the object cannot die, so nobody has to look at
+// the sum. When it is released, every shard is folded into one atomic counter, and from then on
+// the remaining copies count there like an ordinary `SharedPtr`.
+template <typename T>
+class ShardedControlBlock {
+public:
+    static constexpr size_t kShards = 64;
+
+    template <typename... Args>
+    ShardedControlBlock(Args&&... args) : value_(std::forward<Args>(args)...) {
+    }
+
+    T* Get() {
+        return &value_;
+    }
+
+    void IncRef() noexcept {
+        // A dead shard has already been folded; adding to it changes nothing
+        auto old = CurrentShard().fetch_add(kOneRef, std::memory_order_relaxed);
+        if (old & kDead) {
+            central_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void DecRef() noexcept {
+        auto old = CurrentShard().fetch_sub(kOneRef, std::memory_order_release);
+        if ((old & kDead) && central_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // Drops the owner's reference. The bias keeps `central_` positive while decrements from
+    // already folded shards arrive before the matching increments are folded in.
+    void ReleaseOwner() noexcept {
+        int64_t sum = 0;
+        for (auto& shard : shards_) {
+            sum += shard.count.exchange(kDead, std::memory_order_acq_rel) / kOneRef;
+        }
+        int64_t delta = sum - kBias;
+        if (central_.fetch_add(delta, std::memory_order_acq_rel) + delta == 0) {
+            delete this;
+        }
+    }
+
+    // Exact only once the owner is gone and nobody is copying
+    size_t UseCount() const noexcept {
+        int64_t count = central_.load(std::memory_order_relaxed);
+        if (count >= kBias / 2) {
+            count -= kBias - 1;
+            for (const auto& shard : shards_) {
+                count += shard.count.load(std::memory_order_relaxed) / kOneRef;
+            }
+        }
+        return count;
+    }
+
+private:
+    // Shards hold the count shifted left by one; the low bit marks a shard that was folded
+    static constexpr int64_t kDead = 1;
+    static constexpr int64_t kOneRef = 2;
+    static constexpr int64_t kBias = int64_t{1} << 62;
+
+    struct alignas(kCacheLineSize) Shard {
+        std::atomic<int64_t> count{0};
+    };
+
+    std::atomic<int64_t>& CurrentShard() noexcept {
+        thread_local size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return shards_[slot].count;
+    }
+
+    Shard shards_[kShards];
+    alignas(kCacheLineSize) std::atomic<int64_t> central_{kBias};
+    T value_;
+
+    inline static std::atomic<size_t> next_slot{0};
+};
+
+template <typename T>
+class ShardedSharedPtr {
+    using Block = ShardedControlBlock<T>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ShardedSharedPtr() {
+    }
+
+    ShardedSharedPtr(std::nullptr_t) {
+    }
+
+    // A copy of the owner is a plain reference
+    ShardedSharedPtr(const ShardedSharedPtr& other) : block_(other.block_) {
+        if (block_) {
+            block_->IncRef();
+        }
+    }
+    ShardedSharedPtr(ShardedSharedPtr&& other) noexcept
+        : block_(other.block_), owner_(other.owner_) {
+        other.block_ = nullptr;
+        other.owner_ = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    ShardedSharedPtr& operator=(const ShardedSharedPtr& other) {
+        ShardedSharedPtr(other).Swap(*this);
+        return *this;
+    }
+    ShardedSharedPtr& operator=(ShardedSharedPtr&& other) noexcept {
+        ShardedSharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ShardedSharedPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() noexcept {
+        if (block_) {
+            if (owner_) {
+                block_->ReleaseOwner();
+            } else {
+                block_->DecRef();
+            }
+        }
+        block_ = nullptr;
+        owner_ = false;
+    }
+
+    void Swap(ShardedSharedPtr& other) noexcept {
+        std::swap(block_, other.block_);
+        std::swap(owner_, other.owner_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return block_ ? block_->Get() : nullptr;
+    }
+    T& operator*() const {
+        return *block_->Get();
+    }
+    T* operator->() const {
+        return block_->Get();
+    }
+    size_t UseCount() const {
+        if (!block_) {
+            return 0;
+        }
+        return block_->UseCount();
+    }
+    bool IsOwner() const {
+        return owner_;
+    }
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+private:
+    Block* block_{nullptr};
+    bool owner_{false};
+
+    template <typename U, typename... Args>
+    friend ShardedSharedPtr<U> MakeShardedShared(Args&&... args);
+};
+
+template <typename T, typename U>
+inline bool operator==(const ShardedSharedPtr<T>& left, const ShardedSharedPtr<U>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ShardedSharedPtr<T>& left, const ShardedSharedPtr<U>& right) {
+    return !(left == right);
+}
+
+// Returns the owner; the object and its shards share one allocation
+template <typename T, typename... Args>
+ShardedSharedPtr<T> MakeShardedShared(Args&&... args) {
+    ShardedSharedPtr<T> sp;
+    sp.block_ = new ShardedControlBlock<T>(std::forward<Args>(args)...);
+    sp.owner_ = true;
+    return sp;
+}
@@ -1,45 +1,311 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
+#include "compressed_pair.h"
 
 #include <cstddef>  // std::nullptr_t
 #include <iostream>
 #include <cassert>
+#include <functional>  // std::less, std::hash
+#include <limits>
+#include <memory>  // std::allocator_traits
+#include <new>  // std::bad_array_new_length
+#include <tuple>  // std::forward_as_tuple
 #include <type_traits>
 
-template <typename U>
-class ControlBlockHolder : public ControlBlockBase {
+template <typename U, typename Policy>
+class ControlBlockHolder : public ControlBlockBase<Policy> {
 public:
     template <typename... Args>
-    ControlBlockHolder(Args&&... args) noexcept {
+    ControlBlockHolder(Args&&... args)
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<U>()) {
         new (&storage_) U(std::forward<Args>(args)...);
+        this->Created();
+    }
+
+    // Trivial types are left uninitialized
+    explicit ControlBlockHolder(ForOverwriteTag)
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<U>()) {
+        new (&storage_) U;
+        this->Created();
     }
 
     U* GetRawPointer() {
         return reinterpret_cast<U*>(&storage_);
     }
 
-    ~ControlBlockHolder() {
-        reinterpret_cast<U*>(&storage_)->~U();
+    // The object is already gone by the time the last weak reference frees the block
+    static void* Manage(ControlBlockBase<Policy>* base, ControlBlockOp op,
+                        const std::type_info*) noexcept {
+        auto self = static_cast<ControlBlockHolder*>(base);
+        if (op == ControlBlockOp::kDestroyObject) {
+            self->GetRawPointer()->~U();
+        } else if (op == ControlBlockOp::kDeallocate) {
+            delete self;
+        } else if (op == ControlBlockOp::kGetObject) {
+            return ObjectAddress(self->GetRawPointer());
+        }
+        return nullptr;
     }
 
-    void ResetPointer() override {
-        reinterpret_cast<U*>(&storage_)->~U();
+    std::aligned_storage_t<sizeof(U), alignof(U)> storage_;
+};
+
+// Array form for `MakeShared<U[]>`: the elements follow the block in the same allocation
+template <typename U, typename Policy>
+class ControlBlockHolder<U[], Policy> : public ControlBlockBase<Policy> {
+    static constexpr size_t kAlign = alignof(U) > alignof(ControlBlockBase<Policy>)
+                                         ? alignof(U)
+                                         : alignof(ControlBlockBase<Policy>);
+
+public:
+    // Every element is constructed from `args...`; on exception the constructed ones are
+    // destroyed again
+    template <typename... Args>
+    static ControlBlockHolder* Create(size_t size, const Args&... args) {
+        return Build(size, [&](U* element) { new (element) U(args...); });
     }
 
-    std::aligned_storage_t<sizeof(U), alignof(U)> storage_;
+    // Default-initializes the elements, so trivial ones are left uninitialized
+    static ControlBlockHolder* Create(size_t size, ForOverwriteTag) {
+        return Build(size, [](U* element) { new (element) U; });
+    }
+
+    U* GetRawPointer() {
+        return reinterpret_cast<U*>(reinterpret_cast<char*>(this) + ElementsOffset());
+    }
+
+    static void* Manage(ControlBlockBase<Policy>* base, ControlBlockOp op,
+                        const std::type_info*) noexcept {
+        auto self = static_cast<ControlBlockHolder*>(base);
+        if (op == ControlBlockOp::kDestroyObject) {
+            U* elements = self->GetRawPointer();
+            for (size_t i = self->size_; i > 0; --i) {
+                elements[i - 1].~U();
+            }
+        } else if (op == ControlBlockOp::kDeallocate) {
+            self->~ControlBlockHolder();
+            Deallocate(self);
+        } else if (op == ControlBlockOp::kGetObject) {
+            return ObjectAddress(self->GetRawPointer());
+        }
+        return nullptr;
+    }
+
+private:
+    explicit ControlBlockHolder(size_t size)
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<U[]>()), size_(size) {
+    }
+
+    template <typename Construct>
+    static ControlBlockHolder* Build(size_t size, Construct construct) {
+        if (size > (std::numeric_limits<size_t>::max() - ElementsOffset()) / sizeof(U)) {
+            throw std::bad_array_new_length();
+        }
+        void* memory = Allocate(ElementsOffset() + size * sizeof(U));
+        auto block = new (memory) ControlBlockHolder(size);
+        U* elements = block->GetRawPointer();
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                construct(elements + constructed);
+            }
+        } catch (...) {
+            block->size_ = constructed;
+            Manage(block, ControlBlockOp::kDestroyObject, nullptr);
+            Manage(block, ControlBlockOp::kDeallocate, nullptr);
+            throw;
+        }
+        block->Created();
+        return block;
+    }
+
+    static constexpr size_t ElementsOffset() {
+        return (sizeof(ControlBlockHolder) + alignof(U) - 1) / alignof(U) * alignof(U);
+    }
+
+    static void* Allocate(size_t bytes) {
+        if constexpr (kAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(bytes, std::align_val_t(kAlign));
+        } else {
+            return ::operator new(bytes);
+        }
+    }
+
+    static void Deallocate(void* memory) {
+        if constexpr (kAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(memory, std::align_val_t(kAlign));
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    size_t size_;
 };
 
+// Same as `ControlBlockHolder`, but the block is allocated through `Alloc` and remembers it
+// (for free if the allocator is empty) to give the memory back
+template <typename U, typename Alloc, typename Policy>
+class ControlBlockAllocHolder : public ControlBlockBase<Policy> {
+    // Room for the object; unlike a value-initialized `std::aligned_storage_t`, creating it
+    // writes nothing
+    struct Storage {
+        Storage() {
+        }
+
+        alignas(U) unsigned char bytes[sizeof(U)];
+    };
+
+public:
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<
+        ControlBlockAllocHolder>;
+    using BlockAllocTraits = std::allocator_traits<BlockAlloc>;
+
+    template <typename... Args>
+    ControlBlockAllocHolder(const BlockAlloc& alloc, Args&&... args)
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<U>()),
+          elem_(std::piecewise_construct, std::forward_as_tuple(), std::forward_as_tuple(alloc)) {
+        new (elem_.template Get<0>().bytes) U(std::forward<Args>(args)...);
+        this->Created();
+    }
+
+    template <typename... Args>
+    static ControlBlockAllocHolder* Create(const Alloc& alloc, Args&&... args) {
+        BlockAlloc block_alloc(alloc);
+        auto block = BlockAllocTraits::allocate(block_alloc, 1);
+        try {
+            new (block) ControlBlockAllocHolder(block_alloc, std::forward<Args>(args)...);
+        } catch (...) {
+            BlockAllocTraits::deallocate(block_alloc, block, 1);
+            throw;
+        }
+        return block;
+    }
+
+    U* GetRawPointer() {
+        return reinterpret_cast<U*>(elem_.template Get<0>().bytes);
+    }
+
+    static void* Manage(ControlBlockBase<Policy>* base, ControlBlockOp op,
+                        const std::type_info*) noexcept {
+        auto self = static_cast<ControlBlockAllocHolder*>(base);
+        if (op == ControlBlockOp::kDestroyObject) {
+            self->GetRawPointer()->~U();
+        } else if (op == ControlBlockOp::kDeallocate) {
+            BlockAlloc block_alloc(self->elem_.template Get<1>());
+            self->~ControlBlockAllocHolder();
+            BlockAllocTraits::deallocate(block_alloc, self, 1);
+        } else if (op == ControlBlockOp::kGetObject) {
+            return ObjectAddress(self->GetRawPointer());
+        }
+        return nullptr;
+    }
+
+private:
+    CompressedTuple<Storage, BlockAlloc> elem_;
+};
+
+// Owns a pointer that `Deleter` frees, for `SharedPtr(ptr, deleter[, alloc])`; the block itself
+// comes from `Alloc`. Both sit next to the pointer in a `CompressedTuple`, so stateless ones take
+// no space.
+template <typename U, typename Deleter, typename Alloc, typename Policy>
+class ControlBlockDeleter : public ControlBlockBase<Policy> {
+    using Pointer = std::remove_extent_t<U>*;
+
+public:
+    using BlockAlloc =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockDeleter>;
+    using BlockAllocTraits = std::allocator_traits<BlockAlloc>;
+
+    template <typename D>
+    ControlBlockDeleter(Pointer ptr, D&& deleter, const BlockAlloc& alloc)
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<U>()),
+          elem_(ptr, alloc, std::forward<D>(deleter)) {
+        this->Created();
+    }
+
+    // If the block cannot be created, `ptr` is handed to `deleter` before rethrowing. The
+    // deleter is only moved into the block if that cannot throw, so it is intact for the call.
+    static ControlBlockDeleter* Create(Pointer ptr, Deleter deleter, const Alloc& alloc) {
+        ControlBlockDeleter* block = nullptr;
+        try {
+            BlockAlloc block_alloc(alloc);
+            block = BlockAllocTraits::allocate(block_alloc, 1);
+            return new (block)
+                ControlBlockDeleter(ptr, std::move_if_noexcept(deleter), block_alloc);
+        } catch (...) {
+            if (block) {
+                BlockAlloc block_alloc(alloc);
+                BlockAllocTraits::deallocate(block_alloc, block, 1);
+            }
+            deleter(ptr);
+            throw;
+        }
+    }
+
+    static void* Manage(ControlBlockBase<Policy>* base, ControlBlockOp op,
+                        const std::type_info* type) noexcept {
+        auto self = static_cast<ControlBlockDeleter*>(base);
+        Pointer ptr = self->elem_.template Get<0>();
+        Deleter& deleter = self->elem_.template Get<2>();
+        if (op == ControlBlockOp::kDestroyObject) {
+            deleter(ptr);
+        } else if (op == ControlBlockOp::kDeallocate) {
+            BlockAlloc block_alloc(self->elem_.template Get<1>());
+            self->~ControlBlockDeleter();
+            BlockAllocTraits::deallocate(block_alloc, self, 1);
+        } else if (op == ControlBlockOp::kGetObject) {
+            return ObjectAddress(ptr);
+        } else if (*type == typeid(Deleter)) {
+            return &deleter;
+        }
+        return nullptr;
+    }
+
+private:
+    // The deleter goes last, so that nothing can throw once it has been moved
+    CompressedTuple<Pointer, BlockAlloc, Deleter> elem_;
+};
+
+// A small object costs two words of bookkeeping: the packed counters and the manager pointer
+#if !defined(SMART_PTRS_DEBUG_BORROWS) && !defined(SMART_PTRS_INSTRUMENTATION)
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockHolder<int, DefaultRefCount>) == 24);
+static_assert(sizeof(void*) != 8 ||
+              sizeof(ControlBlockHolder<void*, SingleThreadedRefCount>) == 24);
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockPointer<int, DefaultRefCount>) == 24);
+static_assert(sizeof(void*) != 8 ||
+              sizeof(ControlBlockAllocHolder<int, std::allocator<int>, DefaultRefCount>) == 24);
+static_assert(sizeof(void*) != 8 ||
+              sizeof(ControlBlockDeleter<int, std::default_delete<int>, std::allocator<int>,
+                                         DefaultRefCount>) == 24);
+static_assert(sizeof(void*) != 8 ||
+              sizeof(ControlBlockDeleter<int[], std::default_delete<int[]>, std::allocator<int>,
+                                         DefaultRefCount>) == 24);
+static_assert(sizeof(void*) != 8 ||
+              sizeof(ControlBlockDeleter<int, void (*)(int*), std::allocator<int>,
+                                         DefaultRefCount>) == 32);
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockHolder<int, PackedRefCount>) == 24);
+#endif
+
+// The cache-line-aligned counters never share a line with the object
+static_assert(sizeof(ControlBlockHolder<int, CacheAlignedRefCount<AtomicRefCount>>) ==
+              2 * kCacheLineSize);
+
 template <typename U>
 class EnableSharedFromThisBase {};
 
-template <typename T>
+template <typename T, typename Policy = DefaultRefCount>
 class EnableSharedFromThis;
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
-template <typename T>
+// `Policy` selects how the control block counts references, see ref_count.h
+// `T` may be an array type (`SharedPtr<int[]>`, `SharedPtr<int[4]>`), the pointer then refers to
+// the first element
+template <typename T, typename Policy>
 class SharedPtr {
 public:
+    using ElementType = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -51,111 +317,115 @@ public:
 
     template <typename U>
     SharedPtr(U* ptr) : ptr_(ptr) {
-        if constexpr (std::is_convertible_v<U*, EnableSharedFromThisBase<U>*>) {
-            EnableSharedFromThisConstruct(ptr_);
-        } else {
-            block_ = new ControlBlockPointer<U>(ptr);
-            block_->ref_counter_ = 1;
-        }
+        CreateBlock(ptr);
+    }
+
+    // The object is freed with `deleter(ptr)` instead of `delete`, which also happens right away
+    // if the control block cannot be allocated
+    template <typename U, typename Deleter>
+    SharedPtr(U* ptr, Deleter deleter)
+        : SharedPtr(ptr, std::move(deleter), std::allocator<char>()) {
+    }
+
+    // Same, with the control block allocated through `alloc`
+    template <typename U, typename Deleter, typename Alloc>
+    SharedPtr(U* ptr, Deleter deleter, const Alloc& alloc) {
+        using Block = ControlBlockDeleter<U, Deleter, Alloc, Policy>;
+        AdoptBlock(ptr, Block::Create(ptr, std::move(deleter), alloc));
+    }
+
+    // Owns no object but still calls `deleter(nullptr)` when the last owner goes, like
+    // `std::shared_ptr`
+    template <typename Deleter>
+    SharedPtr(std::nullptr_t, Deleter deleter)
+        : SharedPtr(nullptr, std::move(deleter), std::allocator<char>()) {
+    }
+
+    template <typename Deleter, typename Alloc>
+    SharedPtr(std::nullptr_t, Deleter deleter, const Alloc& alloc) {
+        using Block = ControlBlockDeleter<T, Deleter, Alloc, Policy>;
+        block_ = Block::Create(nullptr, std::move(deleter), alloc);
     }
 
     SharedPtr(const SharedPtr& other) : ptr_(other.ptr_), block_(other.block_) {
         if (block_) {
-            ++block_->ref_counter_;
+            block_->IncRef();
         }
     }
-    SharedPtr(SharedPtr&& other) : ptr_(std::forward<T*>(other.ptr_)), block_(other.block_) {
-        if (block_) {
-            ++block_->ref_counter_;
-            other.Reset();
-        }
+    // Moves steal the reference and never touch the counters
+    SharedPtr(SharedPtr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
     }
 
-    SharedPtr(T* ptr, ControlBlockBase* block) : ptr_(ptr), block_(block) {
+    SharedPtr(ElementType* ptr, ControlBlockBase<Policy>* block) : ptr_(ptr), block_(block) {
         if (block_) {
-            ++block_->ref_counter_;
+            block_->IncRef();
         }
     }
 
     template <typename U>
-    SharedPtr(const SharedPtr<U>& other) : ptr_(other.ptr_), block_(other.block_) {
+    SharedPtr(const SharedPtr<U, Policy>& other) : ptr_(other.ptr_), block_(other.block_) {
         if (block_) {
-            ++block_->ref_counter_;
+            block_->IncRef();
         }
     }
     template <typename U>
-    SharedPtr(SharedPtr<U>&& other) : ptr_(std::forward<U*>(other.ptr_)), block_(other.block_) {
-        if (block_) {
-            ++block_->ref_counter_;
-            other.Reset();
-        }
+    SharedPtr(SharedPtr<U, Policy>&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
     }
 
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
 
     template <typename U>
-    SharedPtr(const SharedPtr<U>& other, T* ptr) : ptr_(ptr), block_(other.block_) {
-        ++block_->ref_counter_;
+    SharedPtr(const SharedPtr<U, Policy>& other, ElementType* ptr)
+        : ptr_(ptr), block_(other.block_) {
+        if (block_) {
+            block_->IncRef();
+        }
+    }
+    template <typename U>
+    SharedPtr(SharedPtr<U, Policy>&& other, ElementType* ptr) noexcept
+        : ptr_(ptr), block_(other.block_) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
     }
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other) {
-        if (other.block_->ref_counter_ == 0) {
+    explicit SharedPtr(const WeakPtr<T, Policy>& other) {
+        if (!other.block_ || !other.block_->TryIncRef()) {
             throw BadWeakPtr();
         }
         ptr_ = other.ptr_;
         block_ = other.block_;
-        ++block_->ref_counter_;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
+    // Copy-and-swap: equal pointers may still have different owners, and `other` may be owned
+    // by the object this one releases
     SharedPtr& operator=(const SharedPtr& other) {
-        if (ptr_ == other.ptr_) {
-            return *this;
-        }
-        Reset();
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (other.block_) {
-            ++block_->ref_counter_;
-        }
+        SharedPtr(other).Swap(*this);
         return *this;
     }
-    SharedPtr& operator=(SharedPtr&& other) {
-        Reset();
-        ptr_ = std::forward<T*>(other.ptr_);
-        block_ = other.block_;
-        if (other.block_) {
-            ++block_->ref_counter_;
-        }
-        other.Reset();
+    SharedPtr& operator=(SharedPtr&& other) noexcept {
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
     template <typename U>
-    SharedPtr& operator=(const SharedPtr<U>& other) {
-        Reset();
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (other.block_) {
-            ++block_->ref_counter_;
-        }
+    SharedPtr& operator=(const SharedPtr<U, Policy>& other) {
+        SharedPtr(other).Swap(*this);
         return *this;
     }
 
     template <typename U>
-    SharedPtr& operator=(SharedPtr<U>&& other) {
-        Reset();
-        ptr_ = std::forward<U*>(other.ptr_);
-        block_ = other.block_;
-        if (other.block_) {
-            ++block_->ref_counter_;
-        }
-        other.Reset();
+    SharedPtr& operator=(SharedPtr<U, Policy>&& other) noexcept {
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -163,32 +433,15 @@ public:
     // Destructor
 
     ~SharedPtr() noexcept {
-        if (block_) {
-            if (block_->ref_counter_ + block_->weak_counter_ == 1) {
-                delete block_;
-                block_ = nullptr;
-            } else {
-                --block_->ref_counter_;
-            }
-        }
-        if (ptr_ && block_ && block_->ref_counter_ == 0 && block_->weak_counter_ > 0) {
-            block_->ResetPointer();
-        }
-        ptr_ = nullptr;
-        block_ = nullptr;
+        Reset();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    void Reset() {
+    void Reset() noexcept {
         if (block_) {
-            if (block_->ref_counter_ + block_->weak_counter_ == 1) {
-                // block_->~ControlBlockBase();
-                delete block_;
-            } else {
-                --block_->ref_counter_;
-            }
+            block_->DecRef();
         }
         ptr_ = nullptr;
         block_ = nullptr;
@@ -198,15 +451,10 @@ public:
     void Reset(U* ptr) {
         Reset();
         ptr_ = ptr;
-        if constexpr (std::is_convertible_v<U*, EnableSharedFromThisBase<U>*>) {
-            EnableSharedFromThisConstruct(std::forward<U*>(ptr));
-        } else {
-            block_ = new ControlBlockPointer<U>(ptr);
-            block_->ref_counter_ = 1;
-        }
+        CreateBlock(ptr);
     }
 
-    void Swap(SharedPtr& other) {
+    void Swap(SharedPtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
         std::swap(block_, other.block_);
     }
@@ -214,94 +462,335 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
 
-    T* Get() const {
+    ElementType* Get() const {
         return ptr_;
     }
-    T& operator*() const {
+    ElementType& operator*() const {
         return *ptr_;
     }
-    T* operator->() const {
+    ElementType* operator->() const {
         return ptr_;
     }
+    ElementType& operator[](size_t ind) const {
+        static_assert(std::is_array_v<T>, "operator[] is only available for SharedPtr<T[]>");
+        return ptr_[ind];
+    }
     size_t UseCount() const {
         if (!block_) {
             return 0;
         }
-        return block_->ref_counter_;
+        return block_->UseCount();
     }
     explicit operator bool() const {
-        if (!ptr_) {
-            return false;
+        return ptr_ != nullptr;
+    }
+
+    // The deleter passed on construction, or null if there was none or it is not a `D`
+    template <typename D>
+    D* GetDeleter() const {
+        if (!block_) {
+            return nullptr;
         }
-        return (*ptr_);
+        return static_cast<D*>(block_->GetDeleter(typeid(D)));
+    }
+
+    // Ordering, equality and hashing by control block rather than by pointer: aliases of one
+    // object are equivalent, and a `WeakPtr` keeps its place after expiring (see `OwnerLess`)
+    template <typename U>
+    bool OwnerBefore(const SharedPtr<U, Policy>& other) const noexcept {
+        return std::less<ControlBlockBase<Policy>*>()(block_, other.block_);
+    }
+    template <typename U>
+    bool OwnerBefore(const WeakPtr<U, Policy>& other) const noexcept {
+        return std::less<ControlBlockBase<Policy>*>()(block_, other.block_);
+    }
+    template <typename U>
+    bool OwnerEqual(const SharedPtr<U, Policy>& other) const noexcept {
+        return block_ == other.block_;
+    }
+    template <typename U>
+    bool OwnerEqual(const WeakPtr<U, Policy>& other) const noexcept {
+        return block_ == other.block_;
+    }
+    size_t OwnerHash() const noexcept {
+        return std::hash<ControlBlockBase<Policy>*>()(block_);
     }
 
 private:
+    // Takes over the single strong reference a freshly built block starts with
+    void AdoptBlock(ElementType* ptr, ControlBlockBase<Policy>* block) {
+        ptr_ = ptr;
+        block_ = block;
+        if constexpr (!std::is_array_v<T> && kHasSelf<ElementType>) {
+            if (ptr_) {
+                LinkSelf(FindSelf(ptr_));
+            }
+        }
+    }
+
+    // The `EnableSharedFromThis` base of an object, also an indirect one, found by overload
+    // resolution like `std::enable_shared_from_this`; null for types without (or with an
+    // ambiguous) one
+    template <typename U>
+    static EnableSharedFromThis<U, Policy>* FindSelf(
+        const EnableSharedFromThis<U, Policy>* ptr) noexcept {
+        return const_cast<EnableSharedFromThis<U, Policy>*>(ptr);
+    }
+
+    static std::nullptr_t FindSelf(const volatile void*) noexcept {
+        return nullptr;
+    }
+
+    template <typename U>
+    static constexpr bool kHasSelf =
+        !std::is_same_v<decltype(FindSelf(std::declval<U*>())), std::nullptr_t>;
+
+    // Points the object's `EnableSharedFromThis` base at this block
     template <typename U>
-    void EnableSharedFromThisConstruct(EnableSharedFromThis<U>* ptr) {
-        if (!ptr_->self_.ptr_) {
-            block_ = new ControlBlockPointer<U>(ptr_);
-            block_->ref_counter_ = 1;
-            ptr->self_ = *this;
+    void LinkSelf(EnableSharedFromThis<U, Policy>* self) noexcept {
+        WeakPtr<U, Policy>& weak = self->self_;
+        weak.Reset();
+        weak.ptr_ = static_cast<U*>(self);
+        weak.block_ = block_;
+        block_->IncWeak();
+    }
+
+    // The split layout of `MakeSharedSplit`, with the object built by `construct()`
+    template <typename Construct>
+    static SharedPtr MakeSplit(Construct construct) {
+        T* ptr = construct();
+        ControlBlockBase<Policy>* block = nullptr;
+        try {
+            block = new ControlBlockPointer<T, Policy>(ptr);
+        } catch (...) {
+            delete ptr;
+            throw;
+        }
+        SharedPtr sp;
+        sp.AdoptBlock(ptr, block);
+        return sp;
+    }
+
+    // Owning constructors from a raw pointer
+    template <typename U>
+    void CreateBlock(U* ptr) {
+        if constexpr (std::is_array_v<T>) {
+            block_ = new ControlBlockPointer<U[], Policy>(ptr);
+        } else if constexpr (kHasSelf<U>) {
+            EnableSharedFromThisConstruct(ptr);
+        } else {
+            block_ = new ControlBlockPointer<U, Policy>(ptr);
+        }
+    }
+
+    // An object that is already owned shares its block; the block deletes the pointer as
+    // passed, not as its base
+    template <typename U>
+    void EnableSharedFromThisConstruct(U* ptr) {
+        auto self = FindSelf(ptr);
+        if (!self->self_.block_) {
+            block_ = new ControlBlockPointer<U, Policy>(ptr);
+            LinkSelf(self);
             return;
         }
-        block_ = ptr->self_.block_;
-        ++block_->ref_counter_;
+        block_ = self->self_.block_;
+        block_->IncRef();
     }
 
-    T* ptr_{nullptr};
-    ControlBlockBase* block_{nullptr};
+    ElementType* ptr_{nullptr};
+    ControlBlockBase<Policy>* block_{nullptr};
 
-    template <typename U, typename... Args>
-    friend SharedPtr<U> MakeShared(Args&&... args);
+    template <typename U, typename P, typename... Args>
+    friend SharedPtr<U, P> MakeShared(Args&&... args);
 
-    template <typename U>
+    template <typename U, typename P, typename... Args>
+    friend SharedPtr<U, P> MakeSharedSplit(Args&&... args);
+
+    template <typename U, typename P, typename... Size>
+    friend SharedPtr<U, P> MakeSharedForOverwrite(Size... size);
+
+    template <typename U, typename P, typename Alloc, typename... Args>
+    friend SharedPtr<U, P> AllocateShared(const Alloc& alloc, Args&&... args);
+
+    template <typename U, typename P>
     friend class SharedPtr;
 
-    template <typename U>
+    template <typename U, typename P>
     friend class WeakPtr;
 
-    template <typename U>
+    template <typename U, typename P>
     friend class EnableSharedFromThis;
+
+    template <typename U>
+    friend class AtomicSharedPtr;
+
+    template <typename U, typename P>
+    friend class Borrowed;
+
+    template <typename U, typename P>
+    friend class LocalSharedPtr;
+
+    template <typename U, typename P, typename... Args>
+    friend LocalSharedPtr<U, P> MakeLocalShared(Args&&... args);
+
+    template <typename U, typename P>
+    friend class CompactSharedPtr;
+
+    template <typename U, typename P, typename... Args>
+    friend CompactSharedPtr<U, P> MakeCompactShared(Args&&... args);
+
+    friend class CycleTracer;
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
+template <typename T, typename U, typename Policy>
+inline bool operator==(const SharedPtr<T, Policy>& left, const SharedPtr<U, Policy>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename U, typename Policy>
+inline bool operator!=(const SharedPtr<T, Policy>& left, const SharedPtr<U, Policy>& right) {
+    return !(left == right);
+}
 
+// Casts share ownership through the aliasing constructor; the rvalue overloads steal the
+// reference instead (a failed `DynamicPointerCast` leaves its argument untouched)
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> StaticPointerCast(const SharedPtr<U, Policy>& other) {
+    using Element = typename SharedPtr<T, Policy>::ElementType;
+    return SharedPtr<T, Policy>(other, static_cast<Element*>(other.Get()));
 }
 
-// Allocate memory only once
-template <typename U, typename... Args>
-SharedPtr<U> MakeShared(Args&&... args) {
-    auto block = new ControlBlockHolder<U>(std::forward<Args>(args)...);
-    SharedPtr<U> sp(block->GetRawPointer(), block);
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> StaticPointerCast(SharedPtr<U, Policy>&& other) {
+    using Element = typename SharedPtr<T, Policy>::ElementType;
+    auto ptr = static_cast<Element*>(other.Get());
+    return SharedPtr<T, Policy>(std::move(other), ptr);
+}
+
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> DynamicPointerCast(const SharedPtr<U, Policy>& other) {
+    using Element = typename SharedPtr<T, Policy>::ElementType;
+    if (auto ptr = dynamic_cast<Element*>(other.Get())) {
+        return SharedPtr<T, Policy>(other, ptr);
+    }
+    return SharedPtr<T, Policy>();
+}
+
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> DynamicPointerCast(SharedPtr<U, Policy>&& other) {
+    using Element = typename SharedPtr<T, Policy>::ElementType;
+    if (auto ptr = dynamic_cast<Element*>(other.Get())) {
+        return SharedPtr<T, Policy>(std::move(other), ptr);
+    }
+    return SharedPtr<T, Policy>();
+}
+
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> ConstPointerCast(const SharedPtr<U, Policy>& other) {
+    using Element = typename SharedPtr<T, Policy>::ElementType;
+    return SharedPtr<T, Policy>(other, const_cast<Element*>(other.Get()));
+}
+
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> ConstPointerCast(SharedPtr<U, Policy>&& other) {
+    using Element = typename SharedPtr<T, Policy>::ElementType;
+    auto ptr = const_cast<Element*>(other.Get());
+    return SharedPtr<T, Policy>(std::move(other), ptr);
+}
+
+// Objects of at least this many bytes get the split layout of `MakeSharedSplit` from `MakeShared`
+#ifndef SMART_PTRS_SPLIT_LAYOUT_THRESHOLD
+#define SMART_PTRS_SPLIT_LAYOUT_THRESHOLD 4096
+#endif
+
+// The object and the control block are allocated separately, as with `SharedPtr(new U(...))`,
+// so the object's memory is returned as soon as the last strong reference goes away, even while
+// `WeakPtr`s keep the block alive
+template <typename U, typename Policy = DefaultRefCount, typename... Args>
+SharedPtr<U, Policy> MakeSharedSplit(Args&&... args) {
+    static_assert(!std::is_array_v<U>, "MakeSharedSplit does not support arrays");
+    return SharedPtr<U, Policy>::MakeSplit([&] { return new U(std::forward<Args>(args)...); });
+}
+
+// Allocate memory only once, unless `U` is large (see `SMART_PTRS_SPLIT_LAYOUT_THRESHOLD`)
+// `MakeShared<U[]>(n, args...)` and `MakeShared<U[N]>(args...)` build every element from
+// `args...`, for arrays the block and all elements share the allocation too
+template <typename U, typename Policy = DefaultRefCount, typename... Args>
+SharedPtr<U, Policy> MakeShared(Args&&... args) {
+    SharedPtr<U, Policy> sp;
+    if constexpr (std::is_array_v<U> && std::extent_v<U> == 0) {
+        auto block = ControlBlockHolder<std::remove_extent_t<U>[], Policy>::Create(args...);
+        sp.AdoptBlock(block->GetRawPointer(), block);
+    } else if constexpr (std::is_array_v<U>) {
+        using Holder = ControlBlockHolder<std::remove_extent_t<U>[], Policy>;
+        auto block = Holder::Create(std::extent_v<U>, args...);
+        sp.AdoptBlock(block->GetRawPointer(), block);
+    } else if constexpr (sizeof(U) >= SMART_PTRS_SPLIT_LAYOUT_THRESHOLD) {
+        return MakeSharedSplit<U, Policy>(std::forward<Args>(args)...);
+    } else {
+        auto block = new ControlBlockHolder<U, Policy>(std::forward<Args>(args)...);
+        sp.AdoptBlock(block->GetRawPointer(), block);
+    }
+    return sp;
+}
+
+// Like `MakeShared`, but default-initializes: `MakeSharedForOverwrite<U>()`,
+// `MakeSharedForOverwrite<U[]>(n)` and `MakeSharedForOverwrite<U[N]>()`. Trivial objects and
+// elements are left uninitialized, for buffers that are overwritten right away anyway.
+template <typename U, typename Policy = DefaultRefCount, typename... Size>
+SharedPtr<U, Policy> MakeSharedForOverwrite(Size... size) {
+    static_assert(sizeof...(Size) == (std::is_array_v<U> && std::extent_v<U> == 0 ? 1 : 0),
+                  "only MakeSharedForOverwrite<U[]> takes an argument, the element count");
+    SharedPtr<U, Policy> sp;
+    if constexpr (std::is_array_v<U>) {
+        using Holder = ControlBlockHolder<std::remove_extent_t<U>[], Policy>;
+        size_t count = std::extent_v<U>;
+        ((count = static_cast<size_t>(size)), ...);
+        auto block = Holder::Create(count, ForOverwriteTag());
+        sp.AdoptBlock(block->GetRawPointer(), block);
+    } else if constexpr (sizeof(U) >= SMART_PTRS_SPLIT_LAYOUT_THRESHOLD) {
+        return SharedPtr<U, Policy>::MakeSplit([] { return new U; });
+    } else {
+        auto block = new ControlBlockHolder<U, Policy>(ForOverwriteTag());
+        sp.AdoptBlock(block->GetRawPointer(), block);
+    }
+    return sp;
+}
+
+// Same single allocation, but the memory comes from `alloc` (see pool_allocator.h)
+template <typename U, typename Policy = DefaultRefCount, typename Alloc, typename... Args>
+SharedPtr<U, Policy> AllocateShared(const Alloc& alloc, Args&&... args) {
+    auto block =
+        ControlBlockAllocHolder<U, Alloc, Policy>::Create(alloc, std::forward<Args>(args)...);
+    SharedPtr<U, Policy> sp;
+    sp.AdoptBlock(block->GetRawPointer(), block);
     return sp;
 }
 
 // Look for usage examples in tests
-template <typename T>
+template <typename T, typename Policy>
 class EnableSharedFromThis : public EnableSharedFromThisBase<T> {
 public:
-    SharedPtr<T> SharedFromThis() {
-        return SharedPtr<T>(self_);
+    SharedPtr<T, Policy> SharedFromThis() {
+        return SharedPtr<T, Policy>(self_);
     }
-    SharedPtr<const T> SharedFromThis() const {
-        return SharedPtr<T>(self_);
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        return SharedPtr<T, Policy>(self_);
     }
 
-    WeakPtr<T> WeakFromThis() noexcept {
+    WeakPtr<T, Policy> WeakFromThis() noexcept {
         return self_;
     }
-    WeakPtr<const T> WeakFromThis() const noexcept {
+    WeakPtr<const T, Policy> WeakFromThis() const noexcept {
         return self_;
     }
 
 private:
-    WeakPtr<T> self_;
+    WeakPtr<T, Policy> self_;
 
-    template <typename U>
+    template <typename U, typename P>
     friend class SharedPtr;
 
-    template <typename U>
+    template <typename U, typename P>
     friend class WeakPtr;
 };
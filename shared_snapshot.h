@@ -0,0 +1,244 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation shared by every `SharedSnapshot`.
+//
+// Each thread that reads has a record holding the global epoch it saw when it entered its
+// outermost read section, or 0 while it is outside. Retiring a snapshot advances the global
+// epoch; the snapshot may go once every active record shows that epoch or a later one, since
+// those readers started after it was unpublished. Records are reused after their thread exits
+// and are never freed.
+class SnapshotEpochs {
+    struct alignas(kCacheLineSize) Record {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> in_use{true};
+        Record* next{nullptr};
+    };
+
+    struct LocalRecord {
+        LocalRecord() {
+            for (Record* free = head.load(std::memory_order_acquire); free; free = free->next) {
+                bool expected = false;
+                if (free->in_use.compare_exchange_strong(expected, true,
+                                                         std::memory_order_acquire)) {
+                    record = free;
+                    return;
+                }
+            }
+            record = new Record;
+            record->next = head.load(std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+            }
+        }
+
+        ~LocalRecord() {
+            record->in_use.store(false, std::memory_order_release);
+        }
+
+        Record* record;
+        size_t depth{0};
+    };
+
+public:
+    static void Enter() noexcept {
+        LocalRecord& local = Local();
+        if (local.depth++ == 0) {
+            // Seq-cst so that either the writer's scan sees this store or the following load of
+            // the snapshot sees the writer's new one
+            local.record->epoch.store(global_epoch.load(std::memory_order_acquire),
+                                      std::memory_order_seq_cst);
+        }
+    }
+
+    static void Exit() noexcept {
+        LocalRecord& local = Local();
+        if (--local.depth == 0) {
+            local.record->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    // Call after unpublishing; returns the epoch the retired object is tagged with
+    static uint64_t Advance() noexcept {
+        return global_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    }
+
+    // Whatever was tagged with an epoch up to this one is invisible to every reader
+    static uint64_t OldestActive() noexcept {
+        uint64_t oldest = UINT64_MAX;
+        for (Record* record = head.load(std::memory_order_acquire); record;
+             record = record->next) {
+            uint64_t seen = record->epoch.load(std::memory_order_seq_cst);
+            if (seen != 0 && seen < oldest) {
+                oldest = seen;
+            }
+        }
+        return oldest;
+    }
+
+private:
+    static LocalRecord& Local() noexcept {
+        thread_local LocalRecord local;
+        return local;
+    }
+
+    inline static std::atomic<uint64_t> global_epoch{1};
+    inline static std::atomic<Record*> head{nullptr};
+};
+
+// Read-copy-update publication of an immutable `T`:
+//     SharedSnapshot<Table> table(MakeShared<Table>(...));
+//     {
+//         auto view = table.Read();  // no reference counting
+//         Lookup(*view, key);
+//     }
+//     table.Publish(MakeShared<Table>(*table.Load(), update));
+//
+// A reader enters an epoch-protected section and gets a raw view of the current snapshot;
+// sections nest and cost two stores to a thread-local record. `Publish` swaps in a new snapshot
+// and retires the old one, whose `SharedPtr` is released once every reader that may still see
+// it has left its section. Retired snapshots are checked on each `Publish` and by `Reclaim`.
+//
+// Readers must not block for long inside a section, or reclamation stalls for every
+// `SharedSnapshot`. Destroying a `SharedSnapshot` waits for the grace period, so it must not
+// happen inside a read section of the same thread.
+template <typename T>
+class SharedSnapshot {
+    struct Node {
+        SharedPtr<T> value;
+    };
+
+    struct Retired {
+        Node* node;
+        uint64_t epoch;
+    };
+
+public:
+    // Raw view valid until it goes out of scope
+    class ReadGuard {
+    public:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        ~ReadGuard() {
+            SnapshotEpochs::Exit();
+        }
+
+        const T* Get() const {
+            return node_ ? node_->value.Get() : nullptr;
+        }
+        const T& operator*() const {
+            return *node_->value;
+        }
+        const T* operator->() const {
+            return node_->value.Get();
+        }
+        explicit operator bool() const {
+            return node_ && node_->value;
+        }
+
+        // Keeps the snapshot alive beyond the read section, at the cost of one increment
+        SharedPtr<T> Share() const {
+            return node_ ? node_->value : SharedPtr<T>();
+        }
+
+    private:
+        explicit ReadGuard(const std::atomic<Node*>& current) {
+            SnapshotEpochs::Enter();
+            node_ = current.load(std::memory_order_seq_cst);
+        }
+
+        Node* node_;
+
+        friend class SharedSnapshot;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedSnapshot() {
+    }
+
+    explicit SharedSnapshot(SharedPtr<T> value) : current_(new Node{std::move(value)}) {
+    }
+
+    SharedSnapshot(const SharedSnapshot&) = delete;
+    SharedSnapshot& operator=(const SharedSnapshot&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedSnapshot() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        Retire(current_.exchange(nullptr, std::memory_order_seq_cst));
+        while (!ReclaimLocked()) {
+            guard.unlock();
+            std::this_thread::yield();
+            guard.lock();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Readers
+
+    ReadGuard Read() const {
+        return ReadGuard(current_);
+    }
+
+    // The current snapshot as an ordinary owner
+    SharedPtr<T> Load() const {
+        return Read().Share();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Writers
+
+    void Publish(SharedPtr<T> value) {
+        auto node = new Node{std::move(value)};
+        std::lock_guard<std::mutex> guard(mutex_);
+        Retire(current_.exchange(node, std::memory_order_seq_cst));
+        ReclaimLocked();
+    }
+
+    // Releases the retired snapshots no reader can see any more; returns true if none are left
+    bool Reclaim() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return ReclaimLocked();
+    }
+
+private:
+    void Retire(Node* node) {
+        if (node) {
+            retired_.push_back({node, SnapshotEpochs::Advance()});
+        }
+    }
+
+    bool ReclaimLocked() {
+        if (retired_.empty()) {
+            return true;
+        }
+        uint64_t oldest = SnapshotEpochs::OldestActive();
+        size_t kept = 0;
+        for (const Retired& retired : retired_) {
+            if (retired.epoch <= oldest) {
+                delete retired.node;
+            } else {
+                retired_[kept++] = retired;
+            }
+        }
+        retired_.resize(kept);
+        return kept == 0;
+    }
+
+    std::atomic<Node*> current_{nullptr};
+    std::mutex mutex_;
+    std::vector<Retired> retired_;
+};
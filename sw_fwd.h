@@ -1,44 +1,220 @@
 #pragma once
 
+#include "instrumentation.h"
+#include "ref_count.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 
-class ControlBlockBase {
-public:
-    virtual void ResetPointer() = 0;
-
-    virtual ~ControlBlockBase() = default;
-
-    size_t ref_counter_{0};
-    size_t weak_counter_{0};
+enum class ControlBlockOp {
+    kDestroyObject,  // The last strong reference is gone
+    kDeallocate,     // The last weak reference is gone, free the block itself
+    kGetDeleter,     // Address of the stored deleter if it has the given type, else null
+    kGetObject,      // Address of the object; only meaningful while it is alive
 };
 
+// What a manager returns for `kGetObject`; the object itself may be const
 template <typename U>
-class ControlBlockPointer : public ControlBlockBase {
+void* ObjectAddress(U* ptr) noexcept {
+    return const_cast<void*>(static_cast<const volatile void*>(ptr));
+}
+
+// Only names the pointee type of a block, so that the instrumentation can tell types apart
+template <typename U>
+struct PointeeTag {};
+
+// Asks a block to default-initialize its object instead of value-initializing it, see
+// `MakeSharedForOverwrite`
+struct ForOverwriteTag {};
+
+// Policies that need the pointee type (see cycle_collector.h) define
+// `template <typename U> void OnCreate(PointeeTag<U>)`, called once when the block is created
+template <typename Policy, typename U, typename = void>
+struct HasPointeeHook : std::false_type {};
+
+template <typename Policy, typename U>
+struct HasPointeeHook<Policy, U,
+                      std::void_t<decltype(std::declval<Policy&>().OnCreate(PointeeTag<U>()))>>
+    : std::true_type {};
+
+// `Policy` is one of the counting policies from ref_count.h
+//
+// There is no vtable: each concrete block passes its static `Manage` function, which is the
+// only indirect call and only happens on the final releases.
+//
+// Building with `SMART_PTRS_INSTRUMENTATION` defined makes every block count its allocations and
+// counter operations into the `TypeStats` of its pointee type, see instrumentation.h.
+template <typename Policy>
+class ControlBlockBase : protected Policy {
 public:
-    ControlBlockPointer(U* ptr) : ptr_(ptr) {
+    // `type` is only passed with `kGetDeleter`
+    using Manager = void* (*)(ControlBlockBase*, ControlBlockOp,
+                              const std::type_info* type) noexcept;
+
+    template <typename U>
+    ControlBlockBase(Manager manager, PointeeTag<U>) noexcept : manager_(manager) {
+#ifdef SMART_PTRS_INSTRUMENTATION
+        stats_ = &TypeStats::For<U>();
+#endif
+        if constexpr (HasPointeeHook<Policy, U>::value) {
+            Policy::OnCreate(PointeeTag<U>());
+        }
     }
 
-    void ResetPointer() override {
-        if (ptr_) {
-            delete ptr_;
-            ptr_ = nullptr;
+    void IncRef() noexcept {
+        Policy::AddRef();
+        CountIncrement();
+    }
+
+    bool TryIncRef() noexcept {
+        if (!Policy::TryAddRef()) {
+            return false;
+        }
+        CountIncrement();
+        return true;
+    }
+
+    void DecRef() noexcept {
+        CountDecrement();
+        if (Policy::ReleaseRef()) {
+            DestroyObject();
         }
     }
 
-    ~ControlBlockPointer() override {
-        if (ptr_) {
-            delete ptr_;
+    void IncWeak() noexcept {
+        Policy::AddWeak();
+        CountIncrement();
+    }
+
+    void DecWeak() noexcept {
+        CountDecrement();
+        if (Policy::ReleaseWeak()) {
+#ifdef SMART_PTRS_INSTRUMENTATION
+            stats_->OnDeallocate();
+#endif
+            manager_(this, ControlBlockOp::kDeallocate, nullptr);
         }
     }
 
-    U* ptr_;
+    using Policy::UseCount;
+
+    void* GetDeleter(const std::type_info& type) noexcept {
+        return manager_(this, ControlBlockOp::kGetDeleter, &type);
+    }
+
+    void* GetObject() noexcept {
+        return manager_(this, ControlBlockOp::kGetObject, nullptr);
+    }
+
+#ifdef SMART_PTRS_DEBUG_BORROWS
+    // Live `Borrowed` views of this block, see borrowed.h
+    void AddBorrow() noexcept {
+        borrows_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ReleaseBorrow() noexcept {
+        borrows_.fetch_sub(1, std::memory_order_relaxed);
+    }
+#endif
+
+protected:
+    ~ControlBlockBase() = default;
+
+    // Every concrete block calls this once it is completely built, so that a throwing
+    // constructor of the object leaves the statistics alone
+    void Created() noexcept {
+#ifdef SMART_PTRS_INSTRUMENTATION
+        stats_->OnCreate();
+#endif
+    }
+
+private:
+    // Runs once the strong count has reached zero; policies that find this out later than
+    // `ReleaseRef` (see biased_ref_count.h) call it themselves
+    void DestroyObject() noexcept {
+#ifdef SMART_PTRS_DEBUG_BORROWS
+        // Not an `assert`: with `NDEBUG` the surviving view would go on to touch a freed block
+        if (borrows_.load(std::memory_order_relaxed) != 0) {
+            std::cerr << "a Borrowed view outlived the last owner\n";
+            std::abort();
+        }
+#endif
+#ifdef SMART_PTRS_INSTRUMENTATION
+        stats_->OnDestroyObject();
+#endif
+        manager_(this, ControlBlockOp::kDestroyObject, nullptr);
+        DecWeak();
+    }
+
+    void CountIncrement() noexcept {
+#ifdef SMART_PTRS_INSTRUMENTATION
+        stats_->increments.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void CountDecrement() noexcept {
+#ifdef SMART_PTRS_INSTRUMENTATION
+        stats_->decrements.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    Manager manager_;
+#ifdef SMART_PTRS_DEBUG_BORROWS
+    std::atomic<uint32_t> borrows_{0};
+#endif
+#ifdef SMART_PTRS_INSTRUMENTATION
+    TypeStats* stats_;
+#endif
+
+    friend Policy;
+};
+
+// `U` may be an array type, then the pointer came from `new[]`
+template <typename U, typename Policy>
+class ControlBlockPointer : public ControlBlockBase<Policy> {
+public:
+    ControlBlockPointer(std::remove_extent_t<U>* ptr)
+        : ControlBlockBase<Policy>(&Manage, PointeeTag<U>()), ptr_(ptr) {
+        this->Created();
+    }
+
+    static void* Manage(ControlBlockBase<Policy>* base, ControlBlockOp op,
+                        const std::type_info*) noexcept {
+        auto self = static_cast<ControlBlockPointer*>(base);
+        if (op == ControlBlockOp::kDestroyObject) {
+            if constexpr (std::is_array_v<U>) {
+                delete[] self->ptr_;
+            } else {
+                delete self->ptr_;
+            }
+            self->ptr_ = nullptr;
+        } else if (op == ControlBlockOp::kDeallocate) {
+            delete self;
+        } else if (op == ControlBlockOp::kGetObject) {
+            return ObjectAddress(self->ptr_);
+        }
+        return nullptr;
+    }
+
+    std::remove_extent_t<U>* ptr_;
 };
 
 class BadWeakPtr : public std::exception {};
 
-template <typename T>
+template <typename T, typename Policy = DefaultRefCount>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Policy = DefaultRefCount>
 class WeakPtr;
+
+template <typename T, typename Policy = DefaultRefCount>
+class LocalSharedPtr;
+
+template <typename T, typename Policy = DefaultRefCount>
+class CompactSharedPtr;
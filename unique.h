@@ -2,7 +2,12 @@
 
 #include "compressed_pair.h"
 
+#include <cassert>
 #include <cstddef>  // std::nullptr_t
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 // some deleters
 
@@ -22,6 +27,38 @@ public:
     }
 };
 
+// For arrays from `MakeUniqueAligned`: knows the length, destroys every element and frees the
+// memory with the alignment it was allocated with. A default-constructed one only frees null.
+template <typename T>
+class AlignedArrayDeleter {
+public:
+    AlignedArrayDeleter() = default;
+
+    AlignedArrayDeleter(size_t size, size_t alignment) : size_(size), alignment_(alignment) {
+    }
+
+    void operator()(T* p) const noexcept {
+        if (!p) {
+            return;
+        }
+        for (size_t i = size_; i > 0; --i) {
+            p[i - 1].~T();
+        }
+        ::operator delete(p, std::align_val_t(alignment_));
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+    size_t Alignment() const {
+        return alignment_;
+    }
+
+private:
+    size_t size_{0};
+    size_t alignment_{alignof(T)};
+};
+
 // Primary template
 template <typename T, typename Deleter = DefaultDeleter<T>>
 class UniquePtr {
@@ -54,7 +91,7 @@ public:
 
     template <typename U, typename D>
     UniquePtr(UniquePtr<U, D>&& other) noexcept
-        : elem_({other.elem_.GetFirst(), std::forward<D>(other.elem_.GetSecond())}) {
+        : elem_(other.elem_.GetFirst(), std::forward<D>(other.elem_.GetSecond())) {
         other.elem_.GetFirst() = nullptr;
     }
 
@@ -174,17 +211,13 @@ public:
 
     // Move Constructors
 
-    UniquePtr(UniquePtr<T, Deleter>& other) = delete;
-    UniquePtr& operator=(UniquePtr<T, Deleter>& other) = delete;
-
-    template <typename D>
-    UniquePtr(UniquePtr<T, D>&& other) noexcept :
-          elem_({other.elem_.GetFirst(), std::forward<D>(other.elem_.GetSecond())}){
-    }
+    UniquePtr(const UniquePtr& other) = delete;
+    UniquePtr& operator=(const UniquePtr& other) = delete;
 
     template <typename U, typename D>
     UniquePtr(UniquePtr<U, D>&& other) noexcept
-        : elem_({other.elem_.GetFirst(), std::forward<D>(other.elem_.GetSecond())}) {
+        : elem_(other.elem_.GetFirst(), std::forward<D>(other.elem_.GetSecond())) {
+        other.elem_.GetFirst() = nullptr;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -199,7 +232,9 @@ public:
         T* oldptr = elem_.GetFirst();
         elem_.GetFirst() = other.elem_.GetFirst();
         other.elem_.GetFirst() = nullptr;
-        elem_.GetSecond()(oldptr);
+        if (oldptr != nullptr) {
+            elem_.GetSecond()(oldptr);
+        }
         elem_.GetSecond() = std::forward<Deleter>(other.elem_.GetSecond());
         return *this;
     }
@@ -216,7 +251,9 @@ public:
     // Destructor
 
     ~UniquePtr() {
-        elem_.GetSecond()(elem_.GetFirst());
+        if (elem_.GetFirst() != nullptr) {
+            elem_.GetSecond()(elem_.GetFirst());
+        }
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -234,8 +271,10 @@ public:
             elem_.GetSecond()(oldptr);
         }
     }
+    // The deleters are swapped too, they may know the array's length
     void Swap(UniquePtr& other) {
         std::swap(elem_.GetFirst(), other.elem_.GetFirst());
+        std::swap(elem_.GetSecond(), other.elem_.GetSecond());
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -258,14 +297,27 @@ public:
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
-    // Single-object dereference operators
+    // Element access
 
-    const T operator[](size_t ind) const {
-        return (elem_.GetFirst() + ind);
+    T& operator[](size_t ind) const {
+        return elem_.GetFirst()[ind];
     }
 
-    T& operator[](size_t ind) {
-        return *static_cast<T*>(elem_.GetFirst() + ind);
+    // Span-like access; `Size` and `end` need a deleter that knows the length, such as
+    // `AlignedArrayDeleter`
+    template <typename D = Deleter>
+    auto Size() const -> decltype(std::declval<const D&>().Size()) {
+        return elem_.GetSecond().Size();
+    }
+    T* Data() const {
+        return elem_.GetFirst();
+    }
+    T* begin() const {
+        return elem_.GetFirst();
+    }
+    template <typename D = Deleter>
+    auto end() const -> decltype(std::declval<const D&>().Size(), static_cast<T*>(nullptr)) {
+        return elem_.GetFirst() + Size();
     }
 
 private:
@@ -274,3 +326,69 @@ private:
     template <typename U, typename D>
     friend class UniquePtr;
 };
+
+// `MakeUnique<T>(args...)` and `MakeUnique<T[]>(n)`, the latter value-initializes the elements
+template <typename T, typename... Args>
+std::enable_if_t<!std::is_array_v<T>, UniquePtr<T>> MakeUnique(Args&&... args) {
+    return UniquePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+template <typename T>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0, UniquePtr<T>> MakeUnique(
+    size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]());
+}
+
+// `MakeUniqueForOverwrite<T>()` and `MakeUniqueForOverwrite<T[]>(n)` default-initialize, so
+// trivial objects and elements are left uninitialized, for buffers that are overwritten anyway
+template <typename T>
+std::enable_if_t<!std::is_array_v<T>, UniquePtr<T>> MakeUniqueForOverwrite() {
+    return UniquePtr<T>(new T);
+}
+
+template <typename T>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0, UniquePtr<T>>
+MakeUniqueForOverwrite(size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]);
+}
+
+// Enough for aligned AVX-512 loads and stores, and a whole cache line
+inline constexpr size_t kSimdAlignment = 64;
+
+template <typename T>
+using AlignedArray = UniquePtr<T[], AlignedArrayDeleter<T>>;
+
+// `MakeUniqueAligned<T[]>(n, alignment)`: `n` value-initialized elements, the first one aligned
+// to `alignment` (a power of two, raised to `alignof(T)` if smaller). The pointer knows its
+// `Size()`; do not `Reset` it to anything but null.
+template <typename T>
+AlignedArray<std::remove_extent_t<T>> MakeUniqueAligned(size_t size,
+                                                        size_t alignment = kSimdAlignment) {
+    static_assert(std::is_array_v<T> && std::extent_v<T> == 0,
+                  "MakeUniqueAligned only builds arrays of unknown bound, e.g. float[]");
+    using Element = std::remove_extent_t<T>;
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    if (alignment < alignof(Element)) {
+        alignment = alignof(Element);
+    }
+    if (size > std::numeric_limits<size_t>::max() / sizeof(Element)) {
+        throw std::bad_array_new_length();
+    }
+    auto elements = static_cast<Element*>(
+        ::operator new(size * sizeof(Element), std::align_val_t(alignment)));
+    size_t constructed = 0;
+    try {
+        for (; constructed < size; ++constructed) {
+            new (elements + constructed) Element();
+        }
+    } catch (...) {
+        AlignedArrayDeleter<Element>(constructed, alignment)(elements);
+        throw;
+    }
+    return AlignedArray<Element>(elements, AlignedArrayDeleter<Element>(size, alignment));
+}
+
+static_assert(sizeof(UniquePtr<int>) == sizeof(int*));
+static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*));
+static_assert(sizeof(UniquePtr<int, void (*)(int*)>) == 2 * sizeof(int*));
+static_assert(sizeof(AlignedArray<float>) == 3 * sizeof(void*));
@@ -2,8 +2,10 @@
 
 #include "sw_fwd.h"  // Forward declaration
 
+#include <functional>  // std::less, std::hash
+
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
-template <typename T>
+template <typename T, typename Policy>
 class WeakPtr {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -14,50 +16,32 @@ public:
 
     WeakPtr(const WeakPtr& other) : ptr_(other.ptr_), block_(other.block_) {
         if (block_) {
-            ++block_->weak_counter_;
+            block_->IncWeak();
         }
     }
-    WeakPtr(WeakPtr&& other) : ptr_(other.ptr_), block_(other.block_) {
-        if (block_) {
-            ++block_->weak_counter_;
-            other.Reset();
-        }
+    WeakPtr(WeakPtr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
     }
 
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    WeakPtr(const SharedPtr<T>& other) : ptr_(other.ptr_), block_(other.block_) {
+    WeakPtr(const SharedPtr<T, Policy>& other) : ptr_(other.ptr_), block_(other.block_) {
         if (block_) {
-            ++block_->weak_counter_;
+            block_->IncWeak();
         }
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
+    // Copy-and-swap, as equal pointers may still have different blocks
     WeakPtr& operator=(const WeakPtr& other) {
-        if (ptr_ == other.ptr_) {
-            return *this;
-        }
-        Reset();
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (other.block_) {
-            ++block_->weak_counter_;
-        }
+        WeakPtr(other).Swap(*this);
         return *this;
     }
-    WeakPtr& operator=(WeakPtr&& other) {
-        if (ptr_ == other.ptr_) {
-            return *this;
-        }
-        Reset();
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (other.block_) {
-            ++block_->weak_counter_;
-        }
-        other.Reset();
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
+        WeakPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -71,20 +55,15 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    void Reset() {
+    void Reset() noexcept {
         if (block_) {
-            if (block_->ref_counter_ + block_->weak_counter_ == 1) {
-                // block_->~ControlBlockBase();
-                delete block_;
-            } else {
-                --block_->weak_counter_;
-            }
+            block_->DecWeak();
         }
         ptr_ = nullptr;
         block_ = nullptr;
     }
 
-    void Swap(WeakPtr& other) {
+    void Swap(WeakPtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
         std::swap(block_, other.block_);
     }
@@ -96,25 +75,82 @@ public:
         if (!block_) {
             return 0;
         }
-        return block_->ref_counter_;
+        return block_->UseCount();
     }
     bool Expired() const {
-        return (!block_ || !block_->ref_counter_);
+        return (!block_ || !block_->UseCount());
     }
-    SharedPtr<T> Lock() const {
-        if (block_ && block_->ref_counter_) {
-            return SharedPtr<T>(ptr_, block_);
+    // Only succeeds if the strong count is still non-zero at the moment of the increment
+    SharedPtr<T, Policy> Lock() const {
+        SharedPtr<T, Policy> sp;
+        if (block_ && block_->TryIncRef()) {
+            sp.ptr_ = ptr_;
+            sp.block_ = block_;
         }
-        return SharedPtr<T>();
+        return sp;
+    }
+
+    // Same as the `SharedPtr` ones
+    template <typename U>
+    bool OwnerBefore(const WeakPtr<U, Policy>& other) const noexcept {
+        return std::less<ControlBlockBase<Policy>*>()(block_, other.block_);
+    }
+    template <typename U>
+    bool OwnerBefore(const SharedPtr<U, Policy>& other) const noexcept {
+        return std::less<ControlBlockBase<Policy>*>()(block_, other.block_);
+    }
+    template <typename U>
+    bool OwnerEqual(const WeakPtr<U, Policy>& other) const noexcept {
+        return block_ == other.block_;
+    }
+    template <typename U>
+    bool OwnerEqual(const SharedPtr<U, Policy>& other) const noexcept {
+        return block_ == other.block_;
+    }
+    size_t OwnerHash() const noexcept {
+        return std::hash<ControlBlockBase<Policy>*>()(block_);
     }
 
 private:
-    T* ptr_{nullptr};
-    ControlBlockBase* block_{nullptr};
+    std::remove_extent_t<T>* ptr_{nullptr};
+    ControlBlockBase<Policy>* block_{nullptr};
 
-    template <typename U>
+    template <typename U, typename P>
     friend class SharedPtr;
 
-    template <typename U>
+    template <typename U, typename P>
+    friend class WeakPtr;
+
+    template <typename U, typename P>
     friend class EnableSharedFromThis;
 };
+
+// Owner-based comparison for `SharedPtr` and `WeakPtr` keys, which may be mixed, e.g.
+//     std::map<WeakPtr<Widget>, State, OwnerLess>
+//     std::unordered_map<WeakPtr<Widget>, State, OwnerHasher, OwnerEqual>
+struct OwnerLess {
+    using is_transparent = void;
+
+    template <typename Left, typename Right>
+    bool operator()(const Left& left, const Right& right) const noexcept {
+        return left.OwnerBefore(right);
+    }
+};
+
+struct OwnerEqual {
+    using is_transparent = void;
+
+    template <typename Left, typename Right>
+    bool operator()(const Left& left, const Right& right) const noexcept {
+        return left.OwnerEqual(right);
+    }
+};
+
+struct OwnerHasher {
+    using is_transparent = void;
+
+    template <typename Pointer>
+    size_t operator()(const Pointer& pointer) const noexcept {
+        return pointer.OwnerHash();
+    }
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+// Deduplicates immutable values by key while anyone still uses them:
+//     WeakValueCache<std::string, Schema> schemas;
+//     SharedPtr<Schema> schema = schemas.GetOrCreate(text, text);  // parsed once while alive
+//     WeakValueCache<std::string, std::string> strings;
+//     SharedPtr<std::string> name = strings.Intern(raw);
+//
+// The cache only holds `WeakPtr`s, so a value goes away with its last user. Keys are spread
+// over `stripes` independently locked maps; a miss builds the value with `MakeShared` under its
+// stripe's lock, so concurrent misses on one key still produce one value. If building it
+// throws, the exception propagates and the cache is left as it was.
+//
+// Expired entries are purged incrementally: each value is allocated together with a small
+// header whose destructor runs when the strong count hits zero and grants its stripe a few
+// entry checks of sweeping, which the next operations on that stripe spend. A stripe about to
+// grow is swept completely first, so expired entries never make up most of the table. Values may
+// outlive the cache.
+template <typename K, typename T, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class WeakValueCache {
+    using Map = std::unordered_map<K, WeakPtr<T>, Hash, KeyEqual>;
+
+    // Entries a stripe may check for every value of it that expires
+    static constexpr size_t kSweepCredit = 2;
+    // Upper bound of entries checked by one operation
+    static constexpr size_t kMaxSweepStep = 8;
+
+    // The sweep credit of a stripe (low half) and the number of its live values plus one for the
+    // cache (high half) in one word, so that expiring costs a single atomic add. The values may
+    // outlive the cache; whichever goes last frees it.
+    class SweepCredit {
+        static constexpr uint64_t kOwner = uint64_t{1} << 32;
+
+    public:
+        void AddOwner() noexcept {
+            word_.fetch_add(kOwner, std::memory_order_relaxed);
+        }
+
+        void ReleaseOwner(uint64_t credit) noexcept {
+            uint64_t old = word_.fetch_add(credit - kOwner, std::memory_order_acq_rel);
+            if (old < 2 * kOwner) {
+                delete this;
+            }
+        }
+
+        uint64_t Credit() const noexcept {
+            return word_.load(std::memory_order_relaxed) & (kOwner - 1);
+        }
+
+        // Only under the stripe's lock, so the credit cannot drop below `credit` meanwhile
+        void Spend(uint64_t credit) noexcept {
+            word_.fetch_sub(credit, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> word_{kOwner};
+    };
+
+    struct alignas(kCacheLineSize) Stripe {
+        std::mutex mutex;
+        Map map;
+        SweepCredit* credit = new SweepCredit;
+        // Where the incremental sweep goes on, valid while the map has `cursor_buckets` buckets
+        typename Map::iterator cursor;
+        size_t cursor_buckets{0};
+    };
+
+    // What a miss allocates; the returned `SharedPtr<T>` aliases `value`
+    struct Box {
+        template <typename... Args>
+        explicit Box(SweepCredit* credit, Args&&... args)
+            : credit(credit), value(std::forward<Args>(args)...) {
+            credit->AddOwner();
+        }
+
+        ~Box() {
+            credit->ReleaseOwner(kSweepCredit);
+        }
+
+        SweepCredit* credit;
+        T value;
+    };
+
+public:
+    explicit WeakValueCache(size_t stripes = 16)
+        : stripes_(stripes ? new Stripe[stripes] : throw std::invalid_argument("no stripes")),
+          stripe_count_(stripes) {
+    }
+
+    WeakValueCache(const WeakValueCache&) = delete;
+    WeakValueCache& operator=(const WeakValueCache&) = delete;
+
+    ~WeakValueCache() {
+        for (size_t i = 0; i < stripe_count_; ++i) {
+            stripes_[i].credit->ReleaseOwner(0);
+        }
+    }
+
+    // The live value for `key`, or a new one built from `args...`
+    template <typename... Args>
+    SharedPtr<T> GetOrCreate(const K& key, Args&&... args) {
+        Stripe& stripe = StripeOf(key);
+        std::lock_guard<std::mutex> guard(stripe.mutex);
+        Sweep(stripe);
+        if (NeedsRehash(stripe.map) && stripe.map.find(key) == stripe.map.end()) {
+            PurgeLocked(stripe);
+        }
+        auto [it, inserted] = stripe.map.try_emplace(key);
+        if (!inserted) {
+            if (auto value = it->second.Lock()) {
+                return value;
+            }
+        }
+        SharedPtr<Box> box;
+        try {
+            box = MakeShared<Box>(stripe.credit, std::forward<Args>(args)...);
+        } catch (...) {
+            if (inserted) {
+                // The cursor may only be compared while it is valid, i.e. the table kept its size
+                if (stripe.cursor_buckets == stripe.map.bucket_count() && stripe.cursor == it) {
+                    ++stripe.cursor;
+                }
+                stripe.map.erase(it);
+            }
+            throw;
+        }
+        T* raw = &box->value;
+        SharedPtr<T> value(std::move(box), raw);
+        it->second = value;
+        return value;
+    }
+
+    // Values built from their key
+    SharedPtr<T> Intern(const K& key) {
+        return GetOrCreate(key, key);
+    }
+
+    // The live value for `key`, or null
+    SharedPtr<T> Find(const K& key) {
+        Stripe& stripe = StripeOf(key);
+        std::lock_guard<std::mutex> guard(stripe.mutex);
+        Sweep(stripe);
+        auto it = stripe.map.find(key);
+        if (it == stripe.map.end()) {
+            return SharedPtr<T>();
+        }
+        return it->second.Lock();
+    }
+
+    // Drops every expired entry now
+    void Purge() {
+        for (size_t i = 0; i < stripe_count_; ++i) {
+            std::lock_guard<std::mutex> guard(stripes_[i].mutex);
+            PurgeLocked(stripes_[i]);
+        }
+    }
+
+    // Entries, including expired ones that are not purged yet
+    size_t Size() const {
+        size_t size = 0;
+        for (size_t i = 0; i < stripe_count_; ++i) {
+            std::lock_guard<std::mutex> guard(stripes_[i].mutex);
+            size += stripes_[i].map.size();
+        }
+        return size;
+    }
+
+private:
+    Stripe& StripeOf(const K& key) {
+        // The maps use the low bits of the same hash for their buckets
+        size_t hash = Hash()(key);
+        return stripes_[(hash ^ (hash >> 17)) % stripe_count_];
+    }
+
+    static bool NeedsRehash(const Map& map) {
+        return map.size() + 1 > map.bucket_count() * map.max_load_factor();
+    }
+
+    // Spends the credit granted by expired values on the next few entries
+    static void Sweep(Stripe& stripe) {
+        uint64_t credit = stripe.credit->Credit();
+        if (credit == 0) {
+            return;
+        }
+        size_t steps = credit < kMaxSweepStep ? credit : kMaxSweepStep;
+        stripe.credit->Spend(steps);
+        // Inserting only invalidates the cursor when it rehashes
+        if (stripe.cursor_buckets != stripe.map.bucket_count()) {
+            stripe.cursor = stripe.map.begin();
+            stripe.cursor_buckets = stripe.map.bucket_count();
+        }
+        for (size_t step = 0; step < steps && !stripe.map.empty(); ++step) {
+            if (stripe.cursor == stripe.map.end()) {
+                stripe.cursor = stripe.map.begin();
+            }
+            if (stripe.cursor->second.Expired()) {
+                stripe.cursor = stripe.map.erase(stripe.cursor);
+            } else {
+                ++stripe.cursor;
+            }
+        }
+    }
+
+    static void PurgeLocked(Stripe& stripe) {
+        for (auto it = stripe.map.begin(); it != stripe.map.end();) {
+            if (it->second.Expired()) {
+                it = stripe.map.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        stripe.cursor = stripe.map.begin();
+    }
+
+    std::unique_ptr<Stripe[]> stripes_;
+    size_t stripe_count_;
+};